@@ -0,0 +1,76 @@
+#!/bin/sh
+# Runs every backend on synthetic images of growing size and prints one
+# CSV row per run: the backend, the repetition, then the columns of
+# printPhases in include/timing.h. Seconds per phase are the longest any
+# process spent in it; Mpix/s are over their sum and GB/s over the filter
+# phase, the image being read once and written once.
+#
+# Settings, from the environment:
+#   SIZES     sides of the square images (default: 256 to 32768, doubling)
+#   FORMAT    png, decoded on rank 0 and split by it, going through every
+#             phase, or pgm, memory-mapped a band per process, with no
+#             ingest or scatter and the gather only waiting for the
+#             slowest band (default: png)
+#   WARMUP    untimed runs before each measured series (default: 1)
+#   REPS      measured runs per size and backend (default: 5)
+#   NP        processes of the parallel backends (default: 1)
+#   THREADS   threads per process, -t (default: one per core)
+#   BACKENDS  any of sequential, open-mp and pthreads (default: all three)
+#   ARGS      more options for every run, as in ARGS="-L 2 -e split"
+#   MPIRUN    how parallel backends are started (default: mpirun -np $NP)
+#   OUT       where the CSV goes (default: bin/bench/results.csv)
+
+BIN=bin
+WORK=$BIN/bench
+
+SIZES=${SIZES:-"256 512 1024 2048 4096 8192 16384 32768"}
+FORMAT=${FORMAT:-png}
+WARMUP=${WARMUP:-1}
+REPS=${REPS:-5}
+NP=${NP:-1}
+BACKENDS=${BACKENDS:-"sequential open-mp pthreads"}
+MPIRUN=${MPIRUN:-"mpirun -np $NP"}
+OUT=${OUT:-$WORK/results.csv}
+
+if [ -n "$THREADS" ]; then ARGS="$ARGS -t $THREADS"; fi
+
+mkdir -p $WORK
+echo "backend,rep,procs,threads,width,height,decode,ingest,scatter,filter,gather,encode,total,mpix_s,gb_s" > $OUT
+
+for size in $SIZES; do
+	in=$WORK/in-$size.$FORMAT
+	out=$WORK/out.$FORMAT
+
+	$WORK/synth ${size}x$size $in || exit 1
+
+	for backend in $BACKENDS; do
+		if [ $backend = sequential ]; then
+			run="$BIN/sequential/log-edges"
+		else
+			run="$MPIRUN $BIN/parallel/$backend/log-edges"
+		fi
+
+		rep=0
+
+		while [ $rep -lt $WARMUP ]; do
+			$run $ARGS -o $out $in > /dev/null || exit 1
+			rep=$((rep + 1))
+		done
+
+		rep=0
+
+		while [ $rep -lt $REPS ]; do
+			row=$($run $ARGS -c -o $out $in | grep -E '^[0-9]+,[0-9]+,')
+
+			if [ -z "$row" ]; then
+				echo "$backend failed on $in" >&2
+				exit 1
+			fi
+
+			echo "$backend,$rep,$row" | tee -a $OUT
+			rep=$((rep + 1))
+		done
+	done
+
+	rm -f $in $out
+done
@@ -0,0 +1,29 @@
+#ifndef _INCLUDE_BATCH_
+#define _INCLUDE_BATCH_
+
+#include "options.h"
+
+/* images waiting between two stages of a batch */
+#define BATCH_QUEUE 4
+
+/* index, in the sorted list of images, of the next one a process should
+ * do, or -1 once there are none left */
+typedef int (*next_fn)(void *arg);
+
+/* number of images among the inputs, directories standing for the PNG,
+ * PGM and raw images in them */
+int batchSize(const options *opts);
+
+/* filters the images next gives into files of the same name in the batch
+ * directory. one thread decodes, the calling one filters with filter and
+ * another encodes, up to BATCH_QUEUE images waiting between each, so that
+ * reading and writing files overlap with filtering. next is called on the
+ * decoding thread. returns how many images failed */
+int filterPipeline(const options *opts, filter_fn filter, next_fn next,
+	void *arg);
+
+/* filters images part, part + parts, ... of the inputs, for the processes
+ * of a job to share them. returns how many images failed */
+int filterBatch(const options *opts, filter_fn filter, int part, int parts);
+
+#endif /* _INCLUDE_BATCH_ */
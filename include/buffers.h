@@ -0,0 +1,41 @@
+#ifndef _INCLUDE_BUFFERS_
+#define _INCLUDE_BUFFERS_
+
+/* buffers are aligned to a cache line */
+#define BUFFER_ALIGN 64
+
+/* buffers this large are aligned to, and rounded up to, a huge page */
+#define HUGE_PAGE (2L << 20)
+
+/* buffers a process keeps for reuse */
+#define BUFFER_SLOTS 32
+
+/* a buffer of at least size bytes, BUFFER_ALIGN aligned, and asking the
+ * kernel for transparent huge pages from HUGE_PAGE up. a buffer given back
+ * before is reused if it is at most twice as large, so once the images of
+ * a run have been seen, taking buffers allocates nothing. safe to call
+ * from any thread */
+void* takeBuffer(long size);
+
+/* gives a buffer of takeBuffer back, for later calls to reuse. the
+ * process keeps it until it exits, or until BUFFER_SLOTS others need its
+ * slot. NULL is ignored */
+void giveBuffer(void *buf);
+
+/* per-thread scratch of the filters, one slot per function that needs it
+ * so that nested calls keep their own */
+typedef enum {
+	SCRATCH_SMOOTH, /* smoothed and filtered tiles of -B */
+	SCRATCH_RING,   /* rows saved by filterInPlace */
+	SCRATCH_EDGES,  /* signed rows of -z */
+	SCRATCH_SIGMA,  /* passes and sums of -L */
+	SCRATCH_SLOTS
+} scratch_t;
+
+/* a buffer of at least size bytes, BUFFER_ALIGN aligned, belonging to the
+ * calling thread until its next call with the same slot. it only grows,
+ * so once a thread has seen the largest tile of a run, scratch allocates
+ * nothing. freed when the thread exits */
+void* scratchBuffer(scratch_t slot, long size);
+
+#endif /* _INCLUDE_BUFFERS_ */
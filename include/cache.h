@@ -0,0 +1,43 @@
+#ifndef _INCLUDE_CACHE_
+#define _INCLUDE_CACHE_
+
+#include "mpi.h"
+#include "convolve.h"
+
+/* makes filterTile and filterRows of convolve.h look their results up in
+ * the directory dir first, and save there the ones they had to filter,
+ * so that a rerun on a slightly changed image only filters what changed.
+ * dir is created if missing. NULL goes back to filtering everything. must
+ * be called before any thread filters */
+void cacheSelect(const char *dir);
+const char* cacheSelected();
+
+/* key of a tile: two independent hashes of the same input, one naming
+ * its file and the other stored in it, so that a tile whose name collides
+ * with another's is told apart */
+typedef struct {
+	unsigned long long name, check;
+} tile_key;
+
+/* key of the tile [x0, x1) x [y0, y1) of a w x h image: hashes of the
+ * pixels the selected filter reads for it, filterRadius() around it, of
+ * how much of that lies past the image edges, and of the filter itself */
+tile_key cacheKey(const uByte *src, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine);
+
+/* reads the tile of a key, of columns [x0, x1) and rows rows, writing row
+ * y of it to out + y * w. returns 0, or -1 if it is not in the cache or the
+ * file of its name holds a tile of another size or check, a collision */
+int cacheLoad(tile_key key, uByte *out, int w, int x0, int x1, int rows);
+
+/* saves a tile read the same way, for later runs, with its size and check
+ * ahead of its pixels */
+void cacheStore(tile_key key, const uByte *out, int w, int x0, int x1,
+	int rows);
+
+/* prints how many tiles every process of comm found in the cache, out of
+ * how many it looked up, and how many names collided, and sets the counts
+ * back to 0. every process of comm calls it */
+void printCache(MPI_Comm comm);
+
+#endif /* _INCLUDE_CACHE_ */
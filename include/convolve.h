@@ -0,0 +1,113 @@
+#ifndef _INCLUDE_CONVOLVE_
+#define _INCLUDE_CONVOLVE_
+
+#include "pixelLab.h"
+#include "logcm.h"
+
+/* tile size, in pixels. the 5 rows a tile row reads (5 x 4096 bytes) stay
+ * in L1 while the tile is walked top to bottom, and a whole tile fits in L2 */
+#define TILE_W 4096
+#define TILE_H 64
+
+/* how the laplacian-of-gaussian is evaluated */
+typedef enum {
+	ENGINE_CLAMP, /* every tap clamps its coordinates to the image */
+	ENGINE_SPLIT, /* branch-free interior, clamping only on the 2-pixel frame */
+	ENGINE_SIMD   /* split, with the interior in 16-bit SIMD lanes */
+} engine_t;
+
+/* instruction sets the SIMD engine can use, from worst to best */
+typedef enum {
+	SIMD_NONE, /* falls back to the scalar split engine */
+	SIMD_SSE2,
+	SIMD_AVX2,
+	SIMD_AVX512
+} simd_t;
+
+/* filters n interior pixels, rows[j] pointing at the first of them in
+ * row y - 2 + j, writing to out. returns how many it did, the remainder is
+ * left to the scalar loop */
+typedef int (*simd_row_fn)(const uByte *const *rows, uByte *out, int n);
+
+/* best instruction set this CPU supports */
+simd_t simdDetect();
+
+/* instruction set used by ENGINE_SIMD. defaults to simdDetect() */
+void simdSelect(simd_t simd);
+simd_t simdSelected();
+
+const char* simdName(simd_t simd);
+
+/* interior kernel for an instruction set, NULL for SIMD_NONE */
+simd_row_fn simdRow(simd_t simd);
+
+/* applies lapOfGau to the columns [x0, x1) of a row of width w, reading
+ * from the 5 rows around it, top to bottom */
+void filterRow(const uByte *const *rows, uByte *out, int w, int x0, int x1,
+	engine_t engine);
+
+/* applies lapOfGau to the pixels in [x0, x1) x [y0, y1) of a w x h image
+ * with the given engine, or the sigma of sigmaSelect in separable.h, or
+ * writes the edge map of edgeSelect in edges.h. the smoothing of
+ * blurSelect in smooth.h runs first, within the tile. with cacheSelect in
+ * cache.h, the TILE_W x TILE_H tiles of the whole input the pixels fall in,
+ * see tileOrigin, come from the cache when unchanged. while tracing, see
+ * timing.h, each call is an event */
+void filterTile(const uByte *src, uByte *dst, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine);
+
+/* applies lapOfGau, or the selected sigma, to the rows [y0, y1) of a
+ * w x h image, writing row y to out + (y - y0) * w, so out may hold just
+ * those rows. cached and traced as filterTile is */
+void filterRows(const uByte *src, uByte *out, int w, int h, int y0, int y1,
+	engine_t engine);
+
+/* applies lapOfGau, or the selected sigma, to the whole w x h image, tile
+ * by tile */
+void filterImage(const uByte *src, uByte *dst, int w, int h, engine_t engine);
+
+/* copies the 4 rows around the band [y0, y1) of a w x h image, 2 above
+ * and 2 below, into halo. they are what filterInPlace reads outside the
+ * band, and must be saved before any other band is overwritten */
+void saveHalo(const uByte *img, int w, int h, int y0, int y1, uByte *halo);
+
+/* applies lapOfGau in place to the band [y0, y1) of a w x h image,
+ * keeping the original values of only the last 3 rows it overwrote. halo
+ * comes from saveHalo, and may be NULL when the band is the whole image */
+void filterInPlace(uByte *img, int w, int h, int y0, int y1,
+	const uByte *halo, engine_t engine);
+
+/* compares every engine and supported instruction set against
+ * ENGINE_CLAMP on a w x h image, the unrolled convolution of each kernel
+ * in logcm.h against a plain loop and, when selected, the separable passes
+ * of a sigma against its whole kernel, an edge map in tiles against one
+ * done at once and smoothing within tiles against smoothing first.
+ * returns the number of mismatches */
+int verifyEngines(const uByte *img, int w, int h);
+
+/* rows and columns the filters above read on each side of a pixel: 2 for
+ * lapOfGau, more for a wide sigma, zero crossings or smoothing */
+int filterRadius();
+
+/* where pixel (0, 0) of the images filtered from now on lies in the whole
+ * input, (0, 0) by default. the tiles below, and those of the cache, are
+ * laid from there, so that they line up with the tiles of the whole input
+ * however it was split into bands, blocks or windows. must be called
+ * before any thread filters */
+void tileOrigin(int x, int y);
+void tileOriginOf(int *x, int *y);
+
+/* number of tw x th tiles covering a w x h image */
+int tileCount(int w, int h, int tw = TILE_W, int th = TILE_H);
+
+/* bounds of the t-th tw x th tile of a w x h image, in row-major tile 
+ * order. the tiles on the edges of the image are cut by them */
+void tileBounds(int t, int w, int h, int *x0, int *y0, int *x1, int *y1,
+	int tw = TILE_W, int th = TILE_H);
+
+/* number of spans the rows [y0, y1) split into along the rows of the
+ * tiles of height th, and the bounds of the s-th of them */
+int spanCount(int y0, int y1, int th = TILE_H);
+void spanBounds(int s, int y0, int y1, int *s0, int *s1, int th = TILE_H);
+
+#endif /* _INCLUDE_CONVOLVE_ */
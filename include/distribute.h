@@ -0,0 +1,54 @@
+#ifndef _INCLUDE_DISTRIBUTE_
+#define _INCLUDE_DISTRIBUTE_
+
+#include "mpi.h"
+#include "image.h"
+#include "options.h"
+
+/* filters rows [y0, y1) of the w x h src into out, which holds just those
+ * rows, with the threads of a process */
+typedef void (*rows_fn)(const uByte *src, uByte *out, int w, int h,
+	int y0, int y1, const options *opts);
+
+/* writes every byte of a w x h buffer before anything is received into
+ * it, so that its pages are placed by the threads that will filter them */
+typedef void (*touch_fn)(uByte *mat, int w, int h, const options *opts);
+
+/* how a binary filters with its threads */
+typedef struct {
+	filter_fn filter;
+	rows_fn rows;
+	touch_fn touch; /* may be NULL */
+} backend;
+
+/* process grid of p processes, from -g or else p rows of 1 column.
+ * returns -1 if -g does not multiply to p */
+int gridOf(int p, const options *opts, int *rows, int *cols);
+
+/* bounds of the pixels process r filters in a rows x cols grid over a
+ * w x h image. sizes differ by at most one row and one column */
+void blockBounds(int r, int w, int h, int rows, int cols,
+	int *x0, int *y0, int *x1, int *y1);
+
+/* filters the w x h image img, only read on rank 0, over every process
+ * of comm, each one getting a block of the grid, filterRadius() pixels of
+ * halo being swapped with its neighbours. the results land back in img.
+ * with -P, bands go out and come back in chunks, overlapping the transfers
+ * with filtering. with -H, processes on the same node share one window
+ * holding their node's band. images with fewer rows or columns than a
+ * block needs to swap its halos are filtered by rank 0 alone. time goes
+ * to the scatter, filter and gather phases of timing.h. returns 0, or -1
+ * on every process if -g does not fit comm, which rank 0 prints */
+int distribute(image *img, int w, int h, const options *opts, MPI_Comm comm,
+	const backend *threads);
+
+/* filters a PGM or raw input straight from its mapping into a mapped
+ * output, every process of comm mapping a band of rows of both, plus
+ * filterRadius() rows of halo of the input, so nothing goes through rank
+ * 0. prints the band size and time on rank 0, and with -c the CSV row of
+ * timing.h for count threads per process. every process of comm calls it.
+ * returns 0, or -1 on error, which is printed */
+int distributeMapped(const options *opts, MPI_Comm comm,
+	const backend *threads, int count);
+
+#endif /* _INCLUDE_DISTRIBUTE_ */
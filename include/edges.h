@@ -0,0 +1,25 @@
+#ifndef _INCLUDE_EDGES_
+#define _INCLUDE_EDGES_
+
+#include "convolve.h"
+
+/* makes every filter of convolve.h write a thinned edge map instead of
+ * clamped laplacian-of-gaussian values: 255 where the filter crosses zero
+ * between a pixel and one of its 4 neighbours by at least slope, on the
+ * pixel's non-negative side, and 0 elsewhere. -1 goes back to the values.
+ * must be called before any thread filters */
+void edgeSelect(int slope);
+int edgeSelected();
+
+/* edge map of the pixels in [x0, x1) x [y0, y1) of a w x h image, row y
+ * going to out + (y - y0) * w, in the same pass as the filter: its signed
+ * values only live in a ring of 3 rows of the tile's width, never in a
+ * whole image */
+void edgeSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine);
+
+/* compares the edge map of a w x h image done in small tiles against the
+ * one done at once. returns 1 if they differ */
+int verifyEdges(const uByte *img, int w, int h);
+
+#endif /* _INCLUDE_EDGES_ */
@@ -0,0 +1,16 @@
+#ifndef _INCLUDE_FARM_
+#define _INCLUDE_FARM_
+
+#include "mpi.h"
+#include "batch.h"
+
+/* filters the images of a batch over the processes of comm, rank 0
+ * handing them out one at a time to whichever process asks next, and 
+ * the others decoding, filtering and encoding their own. rank 0 filters
+ * none, so it pays off over plain -b with images of uneven cost and more
+ * than a couple of processes. the others ask from their decoding thread,
+ * which needs MPI_THREAD_SERIALIZED, as the drivers check at start up.
+ * returns how many images of this process failed */
+int farmBatch(const options *opts, filter_fn filter, MPI_Comm comm);
+
+#endif /* _INCLUDE_FARM_ */
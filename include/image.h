@@ -0,0 +1,39 @@
+#ifndef _INCLUDE_IMAGE_
+#define _INCLUDE_IMAGE_
+
+#include "pixelLab.h"
+
+/* 8-bit grayscale image, stored row by row */
+typedef struct {
+	int width, height;
+	uByte *data;
+	bool owned; /* whether data is freed with the image */
+	void *map;  /* file mapping data lives in, unmapped with the image */
+	long mapSize;
+} image;
+
+/* allocates a width x height image. its pixels are left uninitialized,
+ * in a buffer of takeBuffer in buffers.h that deleteImage gives back */
+image* newImage(int width, int height);
+
+/* wraps width x height gray values someone else owns, without copying */
+image* wrapImage(uByte *data, int width, int height);
+
+/* frees the image, and its pixels if it owns or maps them */
+void deleteImage(image *img);
+
+/* averages n RGB triplets into gray values, like PixelLab does */
+void rgbToGray(const uByte *rgb, uByte *gray, long n);
+
+/* copies n gray values into R, G and B, like PixelLab does */
+void grayToRgb(const uByte *gray, uByte *rgb, long n);
+
+/* gray values of a PixelLab image, extracted from its RGB data in a
+ * single pass. PixelLab keeps 3 bytes per pixel even for gray images */
+image* ingest(PixelLab *img);
+
+/* writes gray values into the RGB data of a PixelLab image of the same
+ * size, in a single pass */
+void egress(const image *gray, PixelLab *img);
+
+#endif /* _INCLUDE_IMAGE_ */
@@ -0,0 +1,118 @@
+#ifndef _INCLUDE_KERNEL_
+#define _INCLUDE_KERNEL_
+
+#include <algorithm>
+#include "convolve.h"
+
+/* convolution with a kernel known at compile time, of any odd size. every
+ * tap is spelled out, and the ones of zero weight compile away, so a new
+ * kernel costs no more than its nonzero taps. instantiated with the size,
+ * weight type and kernel, as in convolve<5, char, lapOfGau> */
+
+/* divides by the kernel divisor, if any, and clamps to a gray value */
+static inline int normalize(int sum, int divisor) {
+	if (divisor != 1) sum /= divisor;
+
+	if (sum > 255) sum = 255;
+	if (sum < 0) sum = 0;
+
+	return sum;
+}
+
+/* weighted sums of taps [0, n) of K around column x of N consecutive
+ * rows, tap n being column n / N and row n % N */
+template <int N, typename T, const Kernel<N, T> &K, int n = N * N>
+struct taps {
+	static constexpr int i = (n - 1) / N, j = (n - 1) % N;
+	static constexpr int weight = K[i][j];
+
+	/* x at least N / 2 pixels away from both edges */
+	static inline int interior(const uByte *const *rows, int x) {
+		return taps<N, T, K, n - 1>::interior(rows, x) +
+			(weight ? weight * rows[j][x + i - N / 2] : 0);
+	}
+
+	/* anywhere in a row of width w, replicating the edge columns */
+	static inline int clamped(const uByte *const *rows, int w, int x) {
+		return taps<N, T, K, n - 1>::clamped(rows, w, x) + (weight ?
+			weight * rows[j][std::min(std::max(x + i - N / 2, 0), w - 1)] : 0);
+	}
+};
+
+template <int N, typename T, const Kernel<N, T> &K>
+struct taps<N, T, K, 0> {
+	static inline int interior(const uByte *const *, int) {
+		return 0;
+	}
+
+	static inline int clamped(const uByte *const *, int, int) {
+		return 0;
+	}
+};
+
+/* rows y - N / 2 to y + N / 2 of a w x h image, replicating the edge rows */
+template <int N>
+static inline void kernelRows(const uByte *src, int w, int h, int y,
+	const uByte **rows) {
+	for (int j = 0; j < N; ++j)
+		rows[j] = src + (long) std::min(std::max(y + j - N / 2, 0), h - 1) * w;
+}
+
+/* applies K to the columns [x0, x1) of a row of width w, reading from the
+ * N rows around it. interior columns go through row first, when given,
+ * and the unrolled loop takes whatever it leaves */
+template <int N, typename T, const Kernel<N, T> &K>
+static inline void convolveRow(const uByte *const *rows, uByte *out, int w,
+	int x0, int x1, simd_row_fn row = NULL) {
+	constexpr int divisor = K.divisor();
+
+	/* interior columns of this span */
+	int ix0 = std::min(std::max(x0, N / 2), x1);
+	int ix1 = std::max(std::min(x1, w - N / 2), ix0);
+
+	for (int x = x0; x < ix0; ++x)
+		out[x] = normalize(taps<N, T, K>::clamped(rows, w, x), divisor);
+
+	int x = ix0;
+
+	if (row && ix1 > ix0) {
+		const uByte *at[N];
+
+		for (int j = 0; j < N; ++j) at[j] = rows[j] + ix0;
+
+		x += row(at, out + ix0, ix1 - ix0);
+	}
+
+	for (; x < ix1; ++x)
+		out[x] = normalize(taps<N, T, K>::interior(rows, x), divisor);
+
+	for (int x = ix1; x < x1; ++x)
+		out[x] = normalize(taps<N, T, K>::clamped(rows, w, x), divisor);
+}
+
+/* applies K to the pixels in [x0, x1) x [y0, y1) of a w x h image,
+ * reading from src and writing to dst. borders replicate the edge pixels */
+template <int N, typename T, const Kernel<N, T> &K>
+void convolveTile(const uByte *src, uByte *dst, int w, int h,
+	int x0, int y0, int x1, int y1) {
+	const uByte *rows[N];
+
+	for (int y = y0; y < y1; ++y) {
+		kernelRows<N>(src, w, h, y, rows);
+		convolveRow<N, T, K>(rows, dst + (long) y * w, w, x0, x1);
+	}
+}
+
+/* applies K to the whole w x h image, tile by tile */
+template <int N, typename T, const Kernel<N, T> &K>
+void convolve(const uByte *src, uByte *dst, int w, int h) {
+	int tiles = tileCount(w, h);
+	int x0, y0, x1, y1;
+
+	for (int t = 0; t < tiles; ++t) {
+		tileBounds(t, w, h, &x0, &y0, &x1, &y1);
+		convolveTile<N, T, K>(src, dst, w, h, x0, y0, x1, y1);
+	}
+}
+
+#endif /* _INCLUDE_KERNEL_ */
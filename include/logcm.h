@@ -1,22 +1,142 @@
 #ifndef _INCLUDE_LOGCM_
 #define _INCLUDE_LOGCM_
 
-typedef const char Filter5[5][5];
+/* an N x N filter, N odd, indexed [i][j] with i the column and j the row
+ * offset plus N / 2. weights are scale times the real ones, which only
+ * matters to filters summing to 0: the others are divided by their sum */
+template <int N, typename T = char>
+struct Kernel {
+    static_assert(N % 2 == 1, "kernels need a center tap");
 
-Filter5 average = {
+    static constexpr int size = N;
+    static constexpr int radius = N / 2;
+
+    T weights[N][N];
+    int scale;
+
+    constexpr const T* operator[](int i) const {
+        return weights[i];
+    }
+
+    /* sum of the weights, and of their absolute values */
+    constexpr int sum(int n = 0) const {
+        return n == N * N ? 0 : weights[n / N][n % N] + sum(n + 1);
+    }
+
+    constexpr int absSum(int n = 0) const {
+        return n == N * N ? 0 : (weights[n / N][n % N] < 0 ?
+            -weights[n / N][n % N] : weights[n / N][n % N]) + absSum(n + 1);
+    }
+
+    /* what a weighted sum is divided by */
+    constexpr int divisor() const {
+        return sum() ? sum() : scale;
+    }
+};
+
+typedef Kernel<5> Filter5;
+
+constexpr Filter5 average = {{
     {1, 1, 1, 1, 1},
     {1, 1, 1, 1, 1},
     {1, 1, 1, 1, 1},
     {1, 1, 1, 1, 1},
     {1, 1, 1, 1, 1}
-};
+}, 1};
 
-Filter5 lapOfGau = {
+constexpr Filter5 lapOfGau = {{
     {0,   0, -1,  0,  0},
     {0,  -1, -2, -1,  0},
     {-1, -2, 16, -2, -1},
     {0,  -1, -2, -1,  0},
     {0,   0, -1,  0,  0}
-};
+}, 1};
+
+/* binomial approximation of a gaussian of sigma 1 */
+constexpr Filter5 gaussian = {{
+    {1,  4,  6,  4, 1},
+    {4, 16, 24, 16, 4},
+    {6, 24, 36, 24, 6},
+    {4, 16, 24, 16, 4},
+    {1,  4,  6,  4, 1}
+}, 1};
+
+constexpr Kernel<3> laplacian = {{
+    {0,  -1,  0},
+    {-1,  4, -1},
+    {0,  -1,  0}
+}, 1};
+
+/* compile-time generation of laplacian-of-gaussian kernels of any size
+ * and sigma, weighing as much in total as lapOfGau times their scale */
+namespace logcm {
+
+template <int... I> struct indices {};
+template <int N, int... I> struct makeIndices : makeIndices<N - 1, N - 1, I...> {};
+template <int... I> struct makeIndices<0, I...> { typedef indices<I...> type; };
+
+constexpr double square(double x) {
+    return x * x;
+}
+
+/* exp by its series, halving the exponent until the series converges */
+constexpr double series(double x, int n = 1, double term = 1) {
+    return n > 20 ? term : term + series(x, n + 1, term * x / n);
+}
+
+constexpr double exp(double x) {
+    return x > 0.5 || x < -0.5 ? square(exp(x / 2)) : series(x);
+}
+
+constexpr int round(double x) {
+    return x < 0 ? -(int) (-x + 0.5) : (int) (x + 0.5);
+}
+
+/* negated laplacian of a gaussian of the given sigma, up to a factor,
+ * at an offset of x columns and y rows */
+constexpr double lapOfGauAt(int x, int y, double sigma) {
+    return (1 - (x * x + y * y) / (2 * sigma * sigma)) *
+        exp(-(x * x + y * y) / (2 * sigma * sigma));
+}
+
+/* tap n of an N x N kernel, in [i][j] order */
+constexpr double tapAt(int N, int n, double sigma) {
+    return lapOfGauAt(n / N - N / 2, n % N - N / 2, sigma);
+}
+
+constexpr double absSum(int N, double sigma, int n = 0) {
+    return n == N * N ? 0 : (tapAt(N, n, sigma) < 0 ? -tapAt(N, n, sigma) :
+        tapAt(N, n, sigma)) + absSum(N, sigma, n + 1);
+}
+
+/* tap n rounded, the absolute weights summing to about 32 * scale */
+constexpr int weightAt(int N, int n, double sigma, int scale) {
+    return round(tapAt(N, n, sigma) * 32 * scale / absSum(N, sigma));
+}
+
+/* sum of the rounded taps but the center one */
+constexpr int ringSum(int N, double sigma, int scale, int n = 0) {
+    return n == N * N ? 0 : (n == N * N / 2 ? 0 : weightAt(N, n, sigma, scale)) +
+        ringSum(N, sigma, scale, n + 1);
+}
+
+template <int N, typename T, int... I>
+constexpr Kernel<N, T> lapOfGau(double sigma, int scale, indices<I...>) {
+    /* the center tap takes up the rounding, so that the weights sum to 0 */
+    return Kernel<N, T> {{ (T) (I == N * N / 2 ? -ringSum(N, sigma, scale) :
+        weightAt(N, I, sigma, scale))... }, scale};
+}
+
+}
+
+template <int N, typename T = short>
+constexpr Kernel<N, T> lapOfGauKernel(double sigma, int scale) {
+    return logcm::lapOfGau<N, T>(sigma, scale,
+        typename logcm::makeIndices<N * N>::type());
+}
+
+/* wider laplacians-of-gaussian, for coarser edges */
+constexpr Kernel<7, short> lapOfGau7 = lapOfGauKernel<7>(1.0, 16);
+constexpr Kernel<9, short> lapOfGau9 = lapOfGauKernel<9>(1.4, 16);
 
-#endif /* _INCLUDE_LOGCM_ */
\ No newline at end of file
+#endif /* _INCLUDE_LOGCM_ */
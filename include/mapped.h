@@ -0,0 +1,37 @@
+#ifndef _INCLUDE_MAPPED_
+#define _INCLUDE_MAPPED_
+
+#include "image.h"
+
+/* formats of image files */
+typedef enum {
+	FORMAT_PNG, /* decoded and encoded by PixelLab or libpng */
+	FORMAT_PGM, /* binary 8-bit PGM (P5), memory-mapped */
+	FORMAT_RAW  /* headerless 8-bit gray values, memory-mapped */
+} format_t;
+
+/* format of an image file from its extension: .pgm, .raw or .gray, and
+ * PNG for anything else */
+format_t formatOf(const char *path);
+
+/* reads the size of a PGM or raw image. raw images have no header, so w
+ * and h must already hold their size. returns the offset of the first
+ * pixel, or -1 on error, which is printed */
+long readHeader(const char *path, format_t format, int *w, int *h);
+
+/* creates a PGM or raw file for a w x h image, sized but with its pixels
+ * left unwritten. returns the offset of the first pixel, or -1 on error */
+long createMapped(const char *path, format_t format, int w, int h);
+
+/* maps rows [y0, y1) of a mapped image file whose first pixel is at
+ * offset, so that the pixels stay in the page cache. writable mappings
+ * are shared, and what is written lands in the file. returns NULL on
+ * error, which is printed */
+image* mapRows(const char *path, long offset, int w, int y0, int y1,
+	bool writable);
+
+/* writes a whole image to a PGM or raw file through a mapping. returns 0
+ * on success and -1 on error */
+int saveMapped(const image *img, const char *path, format_t format);
+
+#endif /* _INCLUDE_MAPPED_ */
@@ -0,0 +1,55 @@
+#ifndef _INCLUDE_OPTIONS_
+#define _INCLUDE_OPTIONS_
+
+#include "convolve.h"
+#include "smooth.h"
+
+/* how loops over tiles are scheduled on threads */
+typedef enum {
+	SCHEDULE_STATIC,  /* the same tiles to the same threads every time */
+	SCHEDULE_DYNAMIC, /* a tile at a time to whichever thread is free */
+	SCHEDULE_GUIDED   /* shrinking chunks of tiles */
+} schedule_t;
+
+/* command line options shared by every log-edges binary */
+typedef struct {
+	const char *input; /* image path, the first one in batch mode */
+	char **inputs;     /* image paths or directories, in batch mode */
+	int inputCount;
+	const char *batchDir; /* -b: output directory, for many inputs */
+	bool farm;         /* -f: batch images handed out on demand by rank 0 */
+	const char *output; /* -o: output image path */
+	engine_t engine;   /* -e: convolution engine */
+	double sigma;      /* -L: laplacian-of-gaussian sigma, 0 for lapOfGau */
+	int slope;         /* -z: zero crossings steeper than this, -1 for none */
+	blur_t blur;       /* -B: smoothing before the filter */
+	bool inPlace;      /* -i: filter without a copy of the image */
+	bool stream;       /* -s: decode, filter and encode row by row */
+	int rawWidth, rawHeight; /* -r: size of a headerless raw input */
+	int threads;       /* -t: threads per process, 0 for one per core */
+	schedule_t schedule; /* -S: scheduling of tiles on threads */
+	int tileWidth, tileHeight; /* -T: size of the tiles threads work on */
+	bool hybrid;       /* -H: one shared band per node */
+	bool pipeline;     /* -P: overlap sending bands with filtering them */
+	int gridRows, gridCols; /* -g: process grid, 0 for a band per process */
+	bool verify;       /* -V: check the engines instead of filtering */
+	bool csv;          /* -c: print the time of each phase as a CSV row */
+	const char *trace; /* -j: Chrome trace of phases and tiles, or NULL */
+	bool counters;     /* -C: hardware counters in the trace */
+	const char *cache; /* -k: directory of filtered tiles, or NULL */
+	int roiX, roiY, roiWidth, roiHeight; /* -R: window, 0 wide for none */
+	int levels, finest; /* -p: pyramid levels, 0 for none, and the finest */
+} options;
+
+/* fills opts from the command line. returns 0 on success and -1 when the
+ * arguments are invalid, in which case the usage should be printed */
+int parseOptions(int argc, char *argv[], options *opts);
+
+/* filters the w x h gray values in mat, in place, with the threads of a
+ * binary */
+typedef uByte* (*filter_fn)(uByte *mat, int w, int h, const options *opts);
+
+/* prints how to call the binary */
+void printUsage(const char *prog);
+
+#endif /* _INCLUDE_OPTIONS_ */
@@ -0,0 +1,25 @@
+#ifndef _INCLUDE_POOL_
+#define _INCLUDE_POOL_
+
+/* runs task t of a job, arg being shared by all of its tasks */
+typedef void (*task_fn)(int t, void *arg);
+
+/* persistent worker threads, started once per process */
+typedef struct pool pool;
+
+/* starts a pool of size threads, the calling one included, so that size
+ * - 1 threads are created. size <= 0 means one per core */
+pool* newPool(int size);
+
+/* number of threads running each job, the calling one included */
+int poolSize(const pool *workers);
+
+/* runs tasks 0 to tasks - 1 on the pool and returns once all of them are
+ * done. every thread starts on an even share of them, and threads out of
+ * work steal half of what is left to another one */
+void runPool(pool *workers, int tasks, task_fn fn, void *arg);
+
+/* stops and joins the threads */
+void deletePool(pool *workers);
+
+#endif /* _INCLUDE_POOL_ */
@@ -0,0 +1,48 @@
+#ifndef _INCLUDE_REGION_
+#define _INCLUDE_REGION_
+
+#include "mpi.h"
+#include "image.h"
+#include "options.h"
+
+/* filters the w x h image img, only read on rank 0, over every process
+ * of comm, with the results landing back in img. returns 0, or -1 on
+ * every process */
+typedef int (*whole_fn)(image *img, int w, int h, const options *opts,
+	MPI_Comm comm, void *arg);
+
+/* copies [x0, x1) x [y0, y1) of a w-wide image into dst, which holds
+ * just those pixels */
+void copyWindow(const uByte *src, int w, int x0, int y0, int x1, int y1,
+	uByte *dst);
+
+/* size of level k of a pyramid over a w x h image, halved k times and
+ * rounded up */
+void levelSize(int w, int h, int k, int *lw, int *lh);
+
+/* levels 0 to levels - 1 of a pyramid over img, level 0 being img itself,
+ * each level averaging 2 x 2 pixels of the one before. built in a single
+ * pass over img: every row written completes, every other time, a row of
+ * the next level. the array and every level but 0 are the caller's */
+image** buildPyramid(image *img, int levels);
+
+/* filters only the window of -R of the input and filterRadius() pixels
+ * around it, writing the window to the output. a PNG is only decoded down
+ * to the last of those rows and PGM and raw inputs only have those rows
+ * mapped, keeping just them, and only its columns are copied out. rank 0
+ * reads and writes, and filter splits the window over comm. every process
+ * of comm calls it. returns 0, or -1 on error, which is printed */
+int filterWindow(const options *opts, MPI_Comm comm, whole_fn filter,
+	void *arg);
+
+/* filters the levels of -p of a pyramid over the input, the coarsest
+ * first, writing each one as soon as it is done to the output path with
+ * its level before the extension, as in out-2.png for level 2 of out.png.
+ * stops after the finest level asked for, so that coarse previews come
+ * out first and cheap. rank 0 reads and writes, and filter splits every
+ * level over comm. every process of comm calls it. returns 0, or -1 on
+ * error, which is printed */
+int filterPyramid(const options *opts, MPI_Comm comm, whole_fn filter,
+	void *arg);
+
+#endif /* _INCLUDE_REGION_ */
@@ -0,0 +1,48 @@
+#ifndef _INCLUDE_SEPARABLE_
+#define _INCLUDE_SEPARABLE_
+
+#include "convolve.h"
+
+/* the laplacian-of-gaussian of a runtime sigma reaches this many sigmas
+ * around a pixel */
+#define SIGMA_REACH 4
+
+/* replaces lapOfGau with the laplacian-of-gaussian of the given sigma in
+ * every filter of convolve.h, or goes back to lapOfGau for 0. builds the
+ * kernels, so it must be called before any thread filters */
+void sigmaSelect(double sigma);
+double sigmaSelected();
+
+/* rows and columns the selected sigma reads on each side of a pixel,
+ * ceil(SIGMA_REACH * sigma), or 2 for lapOfGau */
+int sigmaRadius();
+
+/* applies the selected sigma to the pixels in [x0, x1) x [y0, y1) of a
+ * w x h image, writing row y to out + (y - y0) * w, as the gaussian's
+ * second derivative along x times the gaussian along y plus the other way
+ * around: 4 passes of 2 * radius + 1 taps per pixel instead of the
+ * (2 * radius + 1)^2 of the whole kernel. ENGINE_CLAMP convolves with the
+ * whole kernel instead */
+void sigmaSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine);
+
+/* unclamped values of the selected sigma at row y of a w x h image,
+ * columns [x0, x1) going to out[0] onwards. rounded, on the scale of the
+ * gray values sigmaSpan clamps */
+void sigmaSigned(const uByte *src, int w, int h, int y, int x0, int x1,
+	engine_t engine, int *out);
+
+/* most gray levels the separable passes may differ by from the whole
+ * kernel, for any sigma. the whole kernel is shifted to sum to 0 and the
+ * separable one has its derivative shifted too, so they differ by a small
+ * kernel whose absolute weights, times 255, bound the error, plus 1 for
+ * rounding. that comes to 1 for sigmas up to 1.6, grows to 7 at 6.5 and
+ * stays at 8 from 13.5 on, as far as 400 */
+#define SIGMA_BOUND 8
+
+/* compares the separable passes against the whole kernel for the selected
+ * sigma on a w x h image. returns 1 if they differ by more than
+ * SIGMA_BOUND */
+int verifySigma(const uByte *img, int w, int h);
+
+#endif /* _INCLUDE_SEPARABLE_ */
@@ -0,0 +1,26 @@
+#ifndef _INCLUDE_SMOOTH_
+#define _INCLUDE_SMOOTH_
+
+#include "image.h"
+
+/* smoothing run before the filter, to quiet noisy images */
+typedef enum {
+	BLUR_NONE,
+	BLUR_AVERAGE, /* average of logcm.h */
+	BLUR_GAUSSIAN /* gaussian of logcm.h */
+} blur_t;
+
+/* rows and columns a smoothing reads on each side of a pixel */
+#define BLUR_RADIUS 2
+
+/* makes every filter of convolve.h smooth its input first, in the same
+ * tiles. must be called before any thread filters */
+void blurSelect(blur_t blur);
+blur_t blurSelected();
+
+/* smooths the pixels in [x0, x1) x [y0, y1) of a w x h image, borders
+ * replicating the edge pixels, into out, which holds just them */
+void smoothRegion(const uByte *src, int w, int h, int x0, int y0, int x1,
+	int y1, uByte *out);
+
+#endif /* _INCLUDE_SMOOTH_ */
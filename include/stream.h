@@ -0,0 +1,32 @@
+#ifndef _INCLUDE_STREAM_
+#define _INCLUDE_STREAM_
+
+#include "convolve.h"
+#include "image.h"
+
+/* filters the PNG at inPath into an 8-bit gray PNG at outPath, decoding,
+ * filtering and encoding one row at a time. only 5 gray rows are kept,
+ * whatever the height. returns 0 on success and -1 on error, which is
+ * printed. interlaced PNGs cannot be streamed */
+int filterStream(const char *inPath, const char *outPath, engine_t engine);
+
+/* decodes a whole PNG into gray values, averaging RGB like PixelLab does.
+ * unlike PixelLab, which keeps 3 bytes per pixel, libpng can run on many
+ * threads at once. returns NULL on error, which is printed */
+image* readPng(const char *path);
+
+/* reads only the size of a PNG into w and h. returns 0, or -1 on error,
+ * which is printed */
+int readPngSize(const char *path, int *w, int *h);
+
+/* decodes rows [y0, y1) of a PNG the same way, stopping after row y1 - 1,
+ * so only they are kept and none after them decoded. interlaced PNGs are
+ * decoded to the end, every pass reaching every row, but still keep just
+ * the rows asked for. returns NULL on error, which is printed */
+image* readPngRows(const char *path, int y0, int y1);
+
+/* encodes gray values into an 8-bit gray PNG. returns 0 on success and
+ * -1 on error, which is printed */
+int writePng(const image *img, const char *path);
+
+#endif /* _INCLUDE_STREAM_ */
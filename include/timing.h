@@ -0,0 +1,79 @@
+#ifndef _INCLUDE_TIMING_
+#define _INCLUDE_TIMING_
+
+#include "mpi.h"
+
+/* phases the time of a run is split into */
+typedef enum {
+	PHASE_DECODE,  /* reading the input, or mapping it */
+	PHASE_INGEST,  /* converting it to gray values */
+	PHASE_SCATTER, /* sending bands or blocks out, and swapping halos */
+	PHASE_FILTER,  /* convolving */
+	PHASE_GATHER,  /* getting the results back */
+	PHASE_ENCODE,  /* converting and writing the output */
+	PHASE_NONE     /* anything else, which is not timed */
+} phase_t;
+
+#define PHASES PHASE_NONE
+
+/* hardware counters of a trace: cycles and last-level cache misses */
+#define TRACE_COUNTERS 2
+
+/* events a process keeps, later ones being dropped. memory for them is
+ * only taken as they are recorded */
+#define TRACE_EVENTS (1 << 20)
+
+/* charges the time since the last call to the phase it entered, and goes
+ * on with phase. phases and traces read the same monotonic clock. only the
+ * main thread of a process calls it */
+void enterPhase(phase_t phase);
+
+/* seconds charged to a phase so far on this process */
+double phaseTime(phase_t phase);
+
+/* name of a phase, as in the CSV header */
+const char* phaseName(phase_t phase);
+
+/* sets every phase back to 0, for the next run */
+void resetPhases();
+
+/* prints procs,threads,width,height,decode,ingest,scatter,filter,gather,
+ * encode,total,mpix_s,gb_s for a w x h image as a CSV row on rank 0 of
+ * comm, each phase the longest any process spent in it, and total the
+ * longest sum of them. Mpix/s are over the total, and GB/s over the
+ * filter phase, counting the image once read and once written. every
+ * process of comm calls it */
+void printPhases(MPI_Comm comm, int threads, int w, int h);
+
+/* a point in time of the calling thread, and its counters then */
+typedef struct {
+	double at;
+	long long counts[TRACE_COUNTERS]; /* -1 where not counted */
+} mark;
+
+/* starts recording the phases of every process of comm, and the tiles
+ * and rows every thread filters, from a common start. with counters, each
+ * event also gets the cycles and last-level cache misses of its thread,
+ * from perf_event_open, when the kernel allows it. every process of comm
+ * calls it, from its main thread, before any other thread filters */
+void traceStart(MPI_Comm comm, bool counters);
+
+/* whether events are being recorded. everything else below is only
+ * called when they are, which is all tracing costs otherwise */
+bool tracing();
+
+/* now, on the calling thread */
+void traceMark(mark *m);
+
+/* records an event of the calling thread from begin to now. x and y are
+ * where a tile starts, or -1 for phases. name is not copied */
+void traceSpan(const char *name, const mark *begin, int x, int y);
+
+/* writes the events of every process of comm to path on rank 0, as the
+ * JSON trace-event format chrome://tracing and Perfetto load: a process
+ * per rank and a track per thread. stops recording. every process of comm
+ * calls it. returns 0, or -1 on rank 0 if path cannot be written, which is
+ * printed */
+int traceWrite(MPI_Comm comm, const char *path);
+
+#endif /* _INCLUDE_TIMING_ */
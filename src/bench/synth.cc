@@ -0,0 +1,83 @@
+/*
+ ============================================================================
+ Name        : synth.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Synthetic gray images of any size for the benchmarks: disks
+on a gradient with some noise, the same for the same size every time.
+ ============================================================================
+*/
+#include <iostream>
+#include <cstdio>
+#include "image.h"
+#include "mapped.h"
+#include "stream.h"
+
+using std::cout;
+using std::endl;
+
+/* side of the squares each disk sits in */
+#define CELL 64
+
+/* scrambles n into well spread bits */
+static unsigned hash(unsigned n) {
+	n ^= n >> 16;
+	n *= 0x7feb352d;
+	n ^= n >> 15;
+	n *= 0x846ca68b;
+	n ^= n >> 16;
+
+	return n;
+}
+
+/* row y of a w x h image */
+static void synthRow(uByte *row, int w, int h, int y) {
+	int cy = y / CELL;
+
+	for (int x = 0; x < w; ++x) {
+		int cx = x / CELL;
+		unsigned cell = hash(cx * 40503u + cy);
+		int r = 8 + cell % (CELL / 2 - 8);
+		int dx = x % CELL - CELL / 2, dy = y % CELL - CELL / 2;
+		int v = 40 + (int) (((long) x + y) * 120 / ((long) w + h));
+
+		if (dx * dx + dy * dy <= r * r) v += 40 + (cell >> 8) % 80;
+
+		row[x] = v + hash((unsigned) y * w + x) % 16;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int w, h;
+
+	if (argc != 3 || sscanf(argv[1], "%dx%d", &w, &h) != 2 || w < 1 || h < 1) {
+		cout << "Usage: " << argv[0] << " WxH (image path)" << endl;
+		cout << "  .pgm and .raw images are written through a mapping, "
+			"anything else as PNG" << endl;
+
+		return -1;
+	}
+
+	const char *path = argv[2];
+	format_t format = formatOf(path);
+	image *img;
+
+	if (format == FORMAT_PNG) {
+		img = newImage(w, h);
+	} else {
+		long offset = createMapped(path, format, w, h);
+
+		img = offset < 0? NULL : mapRows(path, offset, w, 0, h, true);
+	}
+
+	if (!img) return -1;
+
+	for (int y = 0; y < h; ++y) synthRow(img->data + (long) y * w, w, h, y);
+
+	int result = format == FORMAT_PNG? writePng(img, path) : 0;
+
+	deleteImage(img);
+
+	return result;
+}
@@ -0,0 +1,283 @@
+/*
+ ============================================================================
+ Name        : batch.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Many images through a decode, filter and encode pipeline,
+with bounded queues between the stages.
+ ============================================================================
+*/
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <pthread.h>
+#include <dirent.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "image.h"
+#include "mapped.h"
+#include "stream.h"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+/* an image between two stages. a NULL img past the last one */
+typedef struct {
+	int index; /* in the list of paths */
+	image *img;
+} batch_item;
+
+/* at most BATCH_QUEUE items, pushes waiting while it is full and pops
+ * while it is empty */
+typedef struct {
+	batch_item items[BATCH_QUEUE];
+	int head, count;
+	pthread_mutex_t lock;
+	pthread_cond_t notFull, notEmpty;
+} batch_queue;
+
+typedef struct {
+	const options *opts;
+	const vector<string> *paths;
+	batch_queue *decoded, *filtered;
+	next_fn next;
+	void *arg;
+	int failures; /* of the stage */
+} stage_arg;
+
+/* the static share of filterBatch */
+typedef struct {
+	int next, parts, size;
+} share_arg;
+
+static void initQueue(batch_queue *q) {
+	q->head = q->count = 0;
+
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->notFull, NULL);
+	pthread_cond_init(&q->notEmpty, NULL);
+}
+
+static void destroyQueue(batch_queue *q) {
+	pthread_mutex_destroy(&q->lock);
+	pthread_cond_destroy(&q->notFull);
+	pthread_cond_destroy(&q->notEmpty);
+}
+
+static void push(batch_queue *q, int index, image *img) {
+	pthread_mutex_lock(&q->lock);
+
+	while (q->count == BATCH_QUEUE)
+		pthread_cond_wait(&q->notFull, &q->lock);
+
+	batch_item *item = &q->items[(q->head + q->count) % BATCH_QUEUE];
+
+	item->index = index;
+	item->img = img;
+	q->count++;
+
+	pthread_cond_signal(&q->notEmpty);
+	pthread_mutex_unlock(&q->lock);
+}
+
+static batch_item pop(batch_queue *q) {
+	pthread_mutex_lock(&q->lock);
+
+	while (q->count == 0)
+		pthread_cond_wait(&q->notEmpty, &q->lock);
+
+	batch_item item = q->items[q->head];
+
+	q->head = (q->head + 1) % BATCH_QUEUE;
+	q->count--;
+
+	pthread_cond_signal(&q->notFull);
+	pthread_mutex_unlock(&q->lock);
+
+	return item;
+}
+
+/* whether a file name is one of an image this batch can read */
+static bool isImage(const char *name, const options *opts) {
+	const char *ext = strrchr(name, '.');
+
+	if (!ext) return false;
+
+	if (formatOf(name) == FORMAT_RAW) return opts->rawWidth > 0;
+	if (formatOf(name) == FORMAT_PGM) return true;
+
+	return !strcasecmp(ext, ".png");
+}
+
+/* the input paths, directories replaced by the images in them, sorted so
+ * that every process sees the same list */
+static vector<string> listImages(const options *opts) {
+	vector<string> paths;
+
+	for (int i = 0; i < opts->inputCount; ++i) {
+		const char *input = opts->inputs[i];
+		DIR *dir = opendir(input);
+
+		if (!dir) {
+			paths.push_back(input);
+			continue;
+		}
+
+		for (struct dirent *entry; (entry = readdir(dir)); ) {
+			if (isImage(entry->d_name, opts))
+				paths.push_back(string(input) + "/" + entry->d_name);
+		}
+
+		closedir(dir);
+	}
+
+	std::sort(paths.begin(), paths.end());
+
+	return paths;
+}
+
+/* where the image at path goes, under the same name */
+static string outputOf(const options *opts, const string &path) {
+	size_t slash = path.rfind('/');
+
+	return string(opts->batchDir) + "/" +
+		(slash == string::npos? path : path.substr(slash + 1));
+}
+
+/* gray values of a PNG, PGM or raw image, or NULL on error */
+static image* decode(const char *path, const options *opts) {
+	format_t format = formatOf(path);
+
+	if (format == FORMAT_PNG) return readPng(path);
+
+	int w = opts->rawWidth, h = opts->rawHeight;
+	long offset = readHeader(path, format, &w, &h);
+	image *in = offset < 0? NULL : mapRows(path, offset, w, 0, h, false);
+
+	if (!in) return NULL;
+
+	/* filtered in place, so out of the read-only mapping */
+	image *img = newImage(w, h);
+
+	memcpy(img->data, in->data, sizeof(uByte) * w * h);
+	deleteImage(in);
+
+	return img;
+}
+
+static void* decode_func(void *arg) {
+	stage_arg *s_arg = (stage_arg*) arg;
+	const vector<string> &paths = *s_arg->paths;
+	int i;
+
+	while ((i = s_arg->next(s_arg->arg)) >= 0) {
+		image *img = decode(paths[i].c_str(), s_arg->opts);
+
+		if (img)
+			push(s_arg->decoded, i, img);
+		else
+			s_arg->failures++;
+	}
+
+	push(s_arg->decoded, -1, NULL);
+
+	return NULL;
+}
+
+static void* encode_func(void *arg) {
+	stage_arg *s_arg = (stage_arg*) arg;
+	const vector<string> &paths = *s_arg->paths;
+
+	for (batch_item item; (item = pop(s_arg->filtered)).img; ) {
+		string out = outputOf(s_arg->opts, paths[item.index]);
+		int result;
+
+		if (formatOf(out.c_str()) == FORMAT_PNG)
+			result = writePng(item.img, out.c_str());
+		else
+			result = saveMapped(item.img, out.c_str(), formatOf(out.c_str()));
+
+		if (result != 0) s_arg->failures++;
+
+		deleteImage(item.img);
+	}
+
+	return NULL;
+}
+
+int batchSize(const options *opts) {
+	return listImages(opts).size();
+}
+
+int filterPipeline(const options *opts, filter_fn filter, next_fn next,
+	void *arg) {
+	vector<string> paths = listImages(opts);
+	batch_queue decoded, filtered;
+	pthread_t decoder, encoder;
+	stage_arg decodeArg, encodeArg;
+
+	if (mkdir(opts->batchDir, 0755) != 0 && errno != EEXIST) {
+		cout << "Error: cannot create '" << opts->batchDir << "'." << endl;
+		return paths.size();
+	}
+
+	initQueue(&decoded);
+	initQueue(&filtered);
+
+	decodeArg.opts = encodeArg.opts = opts;
+	decodeArg.paths = encodeArg.paths = &paths;
+	decodeArg.decoded = encodeArg.decoded = &decoded;
+	decodeArg.filtered = encodeArg.filtered = &filtered;
+	decodeArg.next = encodeArg.next = next;
+	decodeArg.arg = encodeArg.arg = arg;
+	decodeArg.failures = encodeArg.failures = 0;
+
+	pthread_create(&decoder, NULL, decode_func, &decodeArg);
+	pthread_create(&encoder, NULL, encode_func, &encodeArg);
+
+	/* the filter stage, on the calling thread and its workers */
+	for (batch_item item; (item = pop(&decoded)).img; ) {
+		filter(item.img->data, item.img->width, item.img->height, opts);
+		push(&filtered, item.index, item.img);
+	}
+
+	push(&filtered, -1, NULL);
+
+	pthread_join(decoder, NULL);
+	pthread_join(encoder, NULL);
+
+	destroyQueue(&decoded);
+	destroyQueue(&filtered);
+
+	return decodeArg.failures + encodeArg.failures;
+}
+
+/* the next image of a static share */
+static int nextShared(void *arg) {
+	share_arg *s_arg = (share_arg*) arg;
+	int i = s_arg->next;
+
+	if (i >= s_arg->size) return -1;
+
+	s_arg->next += s_arg->parts;
+
+	return i;
+}
+
+int filterBatch(const options *opts, filter_fn filter, int part, int parts) {
+	share_arg share;
+
+	share.next = part;
+	share.parts = parts;
+	share.size = batchSize(opts);
+
+	return filterPipeline(opts, filter, nextShared, &share);
+}
@@ -0,0 +1,148 @@
+/*
+ ============================================================================
+ Name        : buffers.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Per-process pool of aligned image buffers, reused from one
+image to the next.
+ ============================================================================
+*/
+#include <cstdlib>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "buffers.h"
+
+/* a buffer of the pool, free or taken */
+typedef struct {
+	void *data;
+	long size;
+	bool taken;
+} slot;
+
+static slot slots[BUFFER_SLOTS];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* the scratch buffers of a thread */
+typedef struct {
+	void *data[SCRATCH_SLOTS];
+	long size[SCRATCH_SLOTS];
+} scratch;
+
+static __thread scratch *own = NULL;
+static pthread_key_t owner; /* frees own when its thread exits */
+static pthread_once_t ownerOnce = PTHREAD_ONCE_INIT;
+
+static void* allocate(long size) {
+	void *data;
+	long align = size >= HUGE_PAGE? HUGE_PAGE : BUFFER_ALIGN;
+
+	if (posix_memalign(&data, align, size) != 0) return NULL;
+
+#ifdef MADV_HUGEPAGE
+	if (size >= HUGE_PAGE) madvise(data, size, MADV_HUGEPAGE);
+#endif
+
+	return data;
+}
+
+void* takeBuffer(long size) {
+	long align = size >= HUGE_PAGE? HUGE_PAGE : BUFFER_ALIGN;
+	int best = -1, spare = -1;
+
+	size = (size + align - 1) / align * align;
+
+	if (size == 0) size = BUFFER_ALIGN;
+
+	pthread_mutex_lock(&lock);
+
+	/* the smallest free buffer large enough, and a slot to put a new one */
+	for (int s = 0; s < BUFFER_SLOTS; ++s) {
+		if (slots[s].taken) continue;
+
+		if (!slots[s].data || slots[s].size < size || slots[s].size > 2 * size) {
+			if (spare < 0 || !slots[s].data) spare = s;
+		} else if (best < 0 || slots[s].size < slots[best].size) {
+			best = s;
+		}
+	}
+
+	if (best >= 0) {
+		slots[best].taken = true;
+		pthread_mutex_unlock(&lock);
+
+		return slots[best].data;
+	}
+
+	/* the slot is held while allocating, which may take a while */
+	if (spare >= 0) {
+		free(slots[spare].data);
+		slots[spare].data = NULL;
+		slots[spare].taken = true;
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	void *data = allocate(size);
+
+	/* not kept if every slot is taken */
+	if (spare < 0) return data;
+
+	pthread_mutex_lock(&lock);
+
+	slots[spare].data = data;
+	slots[spare].size = size;
+	slots[spare].taken = data != NULL;
+
+	pthread_mutex_unlock(&lock);
+
+	return data;
+}
+
+void giveBuffer(void *buf) {
+	if (!buf) return;
+
+	pthread_mutex_lock(&lock);
+
+	for (int s = 0; s < BUFFER_SLOTS; ++s) {
+		if (slots[s].data == buf) {
+			slots[s].taken = false;
+			pthread_mutex_unlock(&lock);
+
+			return;
+		}
+	}
+
+	pthread_mutex_unlock(&lock);
+
+	/* one that got no slot */
+	free(buf);
+}
+
+static void freeScratch(void *arg) {
+	scratch *s = (scratch*) arg;
+
+	for (int k = 0; k < SCRATCH_SLOTS; ++k) free(s->data[k]);
+
+	free(s);
+}
+
+static void makeOwner() {
+	pthread_key_create(&owner, freeScratch);
+}
+
+void* scratchBuffer(scratch_t slot, long size) {
+	if (!own) {
+		pthread_once(&ownerOnce, makeOwner);
+		own = (scratch*) calloc(1, sizeof(scratch));
+		pthread_setspecific(owner, own);
+	}
+
+	if (own->size[slot] < size) {
+		free(own->data[slot]);
+		own->data[slot] = allocate(size);
+		own->size[slot] = own->data[slot]? size : 0;
+	}
+
+	return own->data[slot];
+}
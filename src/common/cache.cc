@@ -0,0 +1,210 @@
+/*
+ ============================================================================
+ Name        : cache.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : On-disk cache of filtered tiles, keyed by a hash of what they
+read, for reruns on images that changed in places.
+ ============================================================================
+*/
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "separable.h"
+#include "edges.h"
+#include "smooth.h"
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+
+/* changes whenever what a key covers, or the file of a tile, does */
+#define CACHE_VERSION 3
+
+/* what a tile file starts with, its pixels following row by row */
+typedef struct {
+	int cols, rows;
+	unsigned long long check;
+} tile_header;
+
+static const char *selected = NULL;
+static long hits = 0, lookups = 0, failed = 0; /* taken atomically */
+static long collisions = 0; /* taken atomically */
+static long written = 0; /* names temporary files, taken atomically */
+
+void cacheSelect(const char *dir) {
+	selected = dir;
+
+	if (dir) mkdir(dir, 0755);
+}
+
+const char* cacheSelected() {
+	return selected;
+}
+
+/* folds 8 bytes into the hash naming a tile */
+static inline unsigned long long mix(unsigned long long h,
+	unsigned long long v) {
+	h ^= v * 0x9e3779b97f4a7c15ULL;
+	h = (h << 31 | h >> 33) * 0xbf58476d1ce4e5b9ULL;
+
+	return h ^ h >> 29;
+}
+
+/* folds them into its check, with other constants and shifts so that the
+ * two do not collide together */
+static inline unsigned long long mixCheck(unsigned long long h,
+	unsigned long long v) {
+	h = (h + v) * 0xc4ceb9fe1a85ec53ULL;
+	h = (h << 27 | h >> 37) * 0x94d049bb133111ebULL;
+
+	return h ^ h >> 32;
+}
+
+/* folds 8 bytes into both hashes of a key */
+static inline void mixKey(tile_key *key, unsigned long long v) {
+	key->name = mix(key->name, v);
+	key->check = mixCheck(key->check, v);
+}
+
+/* folds n bytes, 8 at a time */
+static void mixBytes(tile_key *key, const uByte *p, int n) {
+	unsigned long long v;
+	int k = 0;
+
+	for (; k + 8 <= n; k += 8) {
+		memcpy(&v, p + k, 8);
+		mixKey(key, v);
+	}
+
+	v = n;
+
+	for (; k < n; ++k) v = v << 8 | p[k];
+
+	mixKey(key, v);
+}
+
+tile_key cacheKey(const uByte *src, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	int r = filterRadius();
+	int sx0 = max(x0 - r, 0), sx1 = min(x1 + r, w);
+	int sy0 = max(y0 - r, 0), sy1 = min(y1 + r, h);
+	double sigma = sigmaSelected();
+	unsigned long long bits;
+	tile_key key = {CACHE_VERSION, ~(unsigned long long) CACHE_VERSION};
+
+	/* the filter, and where the image edges replicate */
+	memcpy(&bits, &sigma, 8);
+	mixKey(&key, bits);
+	mixKey(&key, (unsigned long long) edgeSelected() << 32 |
+		blurSelected() << 8 | engine);
+	mixKey(&key, (unsigned long long) (x1 - x0) << 32 | (y1 - y0));
+	mixKey(&key, (unsigned long long) (x0 - sx0) << 32 | (sx1 - x1));
+	mixKey(&key, (unsigned long long) (y0 - sy0) << 32 | (sy1 - y1));
+
+	for (int y = sy0; y < sy1; ++y)
+		mixBytes(&key, src + (long) y * w + sx0, sx1 - sx0);
+
+	return key;
+}
+
+/* file of a key, or of a temporary copy of it when tmp is given */
+static void tilePath(char *path, int size, tile_key key, long tmp = -1) {
+	if (tmp < 0)
+		snprintf(path, size, "%s/%016llx.tile", selected, key.name);
+	else
+		snprintf(path, size, "%s/%016llx.%d.%ld.tmp", selected, key.name,
+			(int) getpid(), tmp);
+}
+
+int cacheLoad(tile_key key, uByte *out, int w, int x0, int x1, int rows) {
+	char path[4096];
+	struct stat st;
+	tile_header header;
+
+	__sync_fetch_and_add(&lookups, 1);
+	tilePath(path, sizeof(path), key);
+
+	FILE *fp = fopen(path, "rb");
+
+	if (!fp) return -1;
+
+	int result = fstat(fileno(fp), &st) == 0 &&
+		st.st_size == (long) sizeof(header) + (long) (x1 - x0) * rows &&
+		fread(&header, sizeof(header), 1, fp) == 1? 0 : -1;
+
+	/* another tile under the same name */
+	if (result == 0 && (header.cols != x1 - x0 || header.rows != rows ||
+		header.check != key.check)) {
+		__sync_fetch_and_add(&collisions, 1);
+		result = -1;
+	}
+
+	for (int y = 0; y < rows && result == 0; ++y) {
+		if (fread(out + (long) y * w + x0, 1, x1 - x0, fp) != (size_t) (x1 - x0))
+			result = -1;
+	}
+
+	fclose(fp);
+
+	if (result == 0) __sync_fetch_and_add(&hits, 1);
+
+	return result;
+}
+
+void cacheStore(tile_key key, const uByte *out, int w, int x0, int x1,
+	int rows) {
+	char path[4096], tmp[4096];
+	tile_header header = {x1 - x0, rows, key.check};
+
+	/* written aside and renamed, so that no reader sees half a tile */
+	tilePath(path, sizeof(path), key);
+	tilePath(tmp, sizeof(tmp), key, __sync_fetch_and_add(&written, 1));
+
+	FILE *fp = fopen(tmp, "wb");
+
+	if (!fp) {
+		__sync_fetch_and_add(&failed, 1);
+		return;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+	for (int y = 0; y < rows && ok; ++y)
+		ok = fwrite(out + (long) y * w + x0, 1, x1 - x0, fp) == (size_t) (x1 - x0);
+
+	ok = fclose(fp) == 0 && ok;
+
+	if (!ok || rename(tmp, path) != 0) {
+		unlink(tmp);
+		__sync_fetch_and_add(&failed, 1);
+	}
+}
+
+void printCache(MPI_Comm comm) {
+	long local[4] = {hits, lookups, failed, collisions}, total[4];
+	int rank;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Reduce(local, total, 4, MPI_LONG, MPI_SUM, 0, comm);
+
+	hits = lookups = failed = collisions = 0;
+
+	if (rank != 0) return;
+
+	cout << "Tiles from cache: " << total[0] << " of " << total[1] << endl;
+
+	if (total[3])
+		cout << "Tiles filtered again after their names collided: " << total[3]
+			<< endl;
+
+	if (total[2])
+		cout << "Error: " << total[2] << " tiles could not be saved to '"
+			<< selected << "'." << endl;
+}
@@ -0,0 +1,417 @@
+/*
+ ============================================================================
+ Name        : convolve.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Cache-blocked 5x5 convolution shared by every log-edges
+binary.
+ ============================================================================
+*/
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "kernel.h"
+#include "separable.h"
+#include "edges.h"
+#include "smooth.h"
+#include "timing.h"
+#include "cache.h"
+#include "buffers.h"
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+
+/* where pixel (0, 0) of the images being filtered lies in the whole input */
+static int originX = 0, originY = 0;
+
+/* weighted sum of a kernel around column x of its rows, replicating the
+ * edge columns. the plain loop the unrolled ones are checked against */
+template <int N, typename T>
+static inline int clampedSum(const uByte *const *rows, int w, int x,
+	const Kernel<N, T> &filter) {
+	int sum = 0;
+
+	for (int j = 0; j < N; ++j) {
+		for (int i = 0; i < N; ++i) {
+			sum += filter[i][j] * rows[j][min(max(x + i - N / 2, 0), w - 1)];
+		}
+	}
+
+	return sum;
+}
+
+void filterRow(const uByte *const *rows, uByte *out, int w, int x0, int x1,
+	engine_t engine) {
+	if (engine == ENGINE_SIMD) {
+		convolveRow<5, char, lapOfGau>(rows, out, w, x0, x1,
+			simdRow(simdSelected()));
+	} else if (engine == ENGINE_SPLIT) {
+		convolveRow<5, char, lapOfGau>(rows, out, w, x0, x1);
+	} else {
+		for (int x = x0; x < x1; ++x)
+			out[x] = normalize(clampedSum(rows, w, x, lapOfGau), 1);
+	}
+}
+
+/* the filter that follows any smoothing, on [x0, x1) x [y0, y1), row y
+ * going to out + (y - y0) * w */
+static void unsmoothedSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	const uByte *rows[5];
+
+	if (edgeSelected() >= 0) {
+		edgeSpan(src, out, w, h, x0, y0, x1, y1, engine);
+		return;
+	}
+
+	if (sigmaSelected() > 0) {
+		sigmaSpan(src, out, w, h, x0, y0, x1, y1, engine);
+		return;
+	}
+
+	for (int y = y0; y < y1; ++y) {
+		kernelRows<5>(src, w, h, y, rows);
+		filterRow(rows, out + (long) (y - y0) * w, w, x0, x1, engine);
+	}
+}
+
+/* rows and columns that filter reads on each side of a pixel */
+static int unsmoothedRadius() {
+	int radius = sigmaSelected() > 0? sigmaRadius() : 2;
+
+	/* zero crossings look at the values of the 4 neighbours */
+	return edgeSelected() >= 0? radius + 1 : radius;
+}
+
+/* smooths and filters [x0, x1) x [y0, y1), row y going to out + (y - y0)
+ * * w, a TILE_W x TILE_H tile at a time. a tile is smoothed along with
+ * the pixels the filter reads around it into a buffer of its own, the
+ * filter running on that buffer as if it were the image: its edges are
+ * those of the image wherever they clamp, so the result is that of
+ * smoothing the whole image first, without ever writing it */
+static void smoothedSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	int r = unsmoothedRadius();
+	int most = (min(x1 - x0, TILE_W) + 2 * r) * (min(y1 - y0, TILE_H) + 2 * r);
+	uByte *smooth = (uByte*) scratchBuffer(SCRATCH_SMOOTH, 2L * most);
+	uByte *filtered = smooth + most;
+
+	for (int ty = y0; ty < y1; ty += TILE_H) {
+		for (int tx = x0; tx < x1; tx += TILE_W) {
+			int ex1 = min(tx + TILE_W, x1), ey1 = min(ty + TILE_H, y1);
+			int sx0 = max(tx - r, 0), sx1 = min(ex1 + r, w);
+			int sy0 = max(ty - r, 0), sy1 = min(ey1 + r, h);
+			int sw = sx1 - sx0, sh = sy1 - sy0;
+
+			smoothRegion(src, w, h, sx0, sy0, sx1, sy1, smooth);
+			unsmoothedSpan(smooth, filtered, sw, sh,
+				tx - sx0, ty - sy0, ex1 - sx0, ey1 - sy0, engine);
+
+			for (int y = ty; y < ey1; ++y) {
+				memcpy(out + (long) (y - y0) * w + tx,
+					filtered + (long) (y - ty) * sw + tx - sx0, ex1 - tx);
+			}
+		}
+	}
+}
+
+/* the selected filter on [x0, x1) x [y0, y1), row y going to
+ * out + (y - y0) * w */
+static void filterSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	if (blurSelected() != BLUR_NONE)
+		smoothedSpan(src, out, w, h, x0, y0, x1, y1, engine);
+	else
+		unsmoothedSpan(src, out, w, h, x0, y0, x1, y1, engine);
+}
+
+/* first row or column of the cell of size size holding v, the cells
+ * starting at origin along that axis */
+static inline int cellStart(int v, int origin, int size) {
+	return v - (v + origin) % size;
+}
+
+/* filterSpan a cell of the cache at a time. the cells are the TILE_W x
+ * TILE_H tiles of the whole input, from the tile origin on, whatever the
+ * span, so that every way of splitting the input looks up the same ones.
+ * a cell the span cuts is keyed as the part of it the span holds. returns
+ * how many cells were not in the cache */
+static int cachedSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	int misses = 0;
+
+	for (int cy = cellStart(y0, originY, TILE_H); cy < y1; cy += TILE_H) {
+		int cy0 = max(cy, y0), cy1 = min(cy + TILE_H, y1);
+		uByte *rows = out + (long) (cy0 - y0) * w;
+
+		for (int cx = cellStart(x0, originX, TILE_W); cx < x1; cx += TILE_W) {
+			int cx0 = max(cx, x0), cx1 = min(cx + TILE_W, x1);
+			tile_key key = cacheKey(src, w, h, cx0, cy0, cx1, cy1, engine);
+
+			if (cacheLoad(key, rows, w, cx0, cx1, cy1 - cy0) == 0) continue;
+
+			filterSpan(src, rows, w, h, cx0, cy0, cx1, cy1, engine);
+			cacheStore(key, rows, w, cx0, cx1, cy1 - cy0);
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+void filterTile(const uByte *src, uByte *dst, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	int misses = 1;
+	mark begin;
+
+	if (tracing()) traceMark(&begin);
+
+	if (cacheSelected())
+		misses = cachedSpan(src, dst + (long) y0 * w, w, h, x0, y0, x1, y1,
+			engine);
+	else
+		filterSpan(src, dst + (long) y0 * w, w, h, x0, y0, x1, y1, engine);
+
+	if (tracing()) traceSpan(misses? "tile" : "cached tile", &begin, x0, y0);
+}
+
+void filterRows(const uByte *src, uByte *out, int w, int h, int y0, int y1,
+	engine_t engine) {
+	int misses = 1;
+	mark begin;
+
+	if (tracing()) traceMark(&begin);
+
+	if (cacheSelected())
+		misses = cachedSpan(src, out, w, h, 0, y0, w, y1, engine);
+	else
+		filterSpan(src, out, w, h, 0, y0, w, y1, engine);
+
+	if (tracing()) traceSpan(misses? "rows" : "cached rows", &begin, 0, y0);
+}
+
+void filterImage(const uByte *src, uByte *dst, int w, int h, engine_t engine) {
+	int tiles = tileCount(w, h);
+	int x0, y0, x1, y1;
+
+	for (int t = 0; t < tiles; ++t) {
+		tileBounds(t, w, h, &x0, &y0, &x1, &y1);
+		filterTile(src, dst, w, h, x0, y0, x1, y1, engine);
+	}
+}
+
+void saveHalo(const uByte *img, int w, int h, int y0, int y1, uByte *halo) {
+	int above = max(y0 - 2, 0);
+	int below = min(y1, h - 1);
+
+	/* rows y0 - 2, y0 - 1, y1 and y1 + 1, replicating the edge rows */
+	memcpy(halo, img + (long) above * w, w);
+	memcpy(halo + w, img + (long) max(y0 - 1, 0) * w, w);
+	memcpy(halo + 2 * w, img + (long) below * w, w);
+	memcpy(halo + 3 * w, img + (long) min(y1 + 1, h - 1) * w, w);
+}
+
+void filterInPlace(uByte *img, int w, int h, int y0, int y1,
+	const uByte *halo, engine_t engine) {
+	/* original values of the last 3 rows overwritten, row y in y % 3 */
+	uByte *ring = (uByte*) scratchBuffer(SCRATCH_RING, 3L * w);
+	const uByte *rows[5];
+
+	for (int y = y0; y < y1; ++y) {
+		memcpy(ring + (y % 3) * w, img + (long) y * w, w);
+
+		for (int j = 0; j < 5; ++j) {
+			int r = min(max(y + j - 2, 0), h - 1);
+
+			if (r < y0)
+				rows[j] = halo + (r - y0 + 2) * w;
+			else if (r <= y)
+				rows[j] = ring + (r % 3) * w;
+			else if (r < y1)
+				rows[j] = img + (long) r * w;
+			else
+				rows[j] = halo + (r - y1 + 2) * w;
+		}
+
+		filterRow(rows, img + (long) y * w, w, 0, w, engine);
+	}
+}
+
+/* compares the unrolled convolution with K against the plain loop on a
+ * w x h image. returns 1 on a mismatch */
+template <int N, typename T, const Kernel<N, T> &K>
+static int verifyKernel(const uByte *img, int w, int h, const char *name) {
+	uByte *expected = (uByte*) malloc(sizeof(uByte) * w * h);
+	uByte *actual = (uByte*) malloc(sizeof(uByte) * w * h);
+	const uByte *rows[N];
+	int failures = 0;
+
+	for (int y = 0; y < h; ++y) {
+		kernelRows<N>(img, w, h, y, rows);
+
+		for (int x = 0; x < w; ++x)
+			expected[x + (long) y * w] =
+				normalize(clampedSum(rows, w, x, K), K.divisor());
+	}
+
+	convolve<N, T, K>(img, actual, w, h);
+
+	if (memcmp(expected, actual, sizeof(uByte) * w * h)) {
+		cout << "Mismatch: " << name << " on " << w << "x" << h << endl;
+		failures++;
+	}
+
+	free(expected);
+	free(actual);
+
+	return failures;
+}
+
+/* compares the selected smoothing fused into the filter's tiles against
+ * smoothing the whole w x h image first. returns 1 if they differ */
+static int verifySmoothing(const uByte *img, int w, int h) {
+	uByte *smooth = (uByte*) malloc(sizeof(uByte) * w * h);
+	uByte *expected = (uByte*) malloc(sizeof(uByte) * w * h);
+	uByte *actual = (uByte*) malloc(sizeof(uByte) * w * h);
+	blur_t blur = blurSelected();
+	int failures = 0;
+
+	smoothRegion(img, w, h, 0, 0, w, h, smooth);
+
+	blurSelect(BLUR_NONE);
+	filterImage(smooth, expected, w, h, ENGINE_SPLIT);
+	blurSelect(blur);
+
+	/* small tiles, so that many of them clamp inside the image */
+	for (int t = 0; t < tileCount(w, h, 64, 16); ++t) {
+		int x0, y0, x1, y1;
+
+		tileBounds(t, w, h, &x0, &y0, &x1, &y1, 64, 16);
+		filterTile(img, actual, w, h, x0, y0, x1, y1, ENGINE_SPLIT);
+	}
+
+	if (memcmp(expected, actual, sizeof(uByte) * w * h)) {
+		cout << "Mismatch: smoothing on " << w << "x" << h << endl;
+		failures++;
+	}
+
+	free(smooth);
+	free(expected);
+	free(actual);
+
+	return failures;
+}
+
+int verifyEngines(const uByte *img, int w, int h) {
+	uByte *expected = (uByte*) malloc(sizeof(uByte) * w * h);
+	uByte *actual = (uByte*) malloc(sizeof(uByte) * w * h);
+	simd_t prev = simdSelected();
+	double sigma = sigmaSelected();
+	int slope = edgeSelected();
+	blur_t blur = blurSelected();
+	const char *cache = cacheSelected();
+	int failures = 0;
+
+	/* the cache would answer in place of the filters being checked */
+	cacheSelect(NULL);
+
+	/* smoothing fused into the tiles against smoothing first, the edge map
+	 * in tiles against at once, the separable passes against the whole
+	 * kernel, then lapOfGau */
+	if (blur != BLUR_NONE) {
+		failures += verifySmoothing(img, w, h);
+		blurSelect(BLUR_NONE);
+	}
+
+	if (slope >= 0) {
+		failures += verifyEdges(img, w, h);
+		edgeSelect(-1);
+	}
+
+	if (sigma > 0) {
+		failures += verifySigma(img, w, h);
+		sigmaSelect(0);
+	}
+
+	filterImage(img, expected, w, h, ENGINE_CLAMP);
+
+	/* the scalar split engine, then the SIMD one on every level */
+	for (int s = SIMD_NONE; s <= simdDetect(); ++s) {
+		simdSelect((simd_t) s);
+		filterImage(img, actual, w, h, s == SIMD_NONE? ENGINE_SPLIT : ENGINE_SIMD);
+
+		if (memcmp(expected, actual, sizeof(uByte) * w * h)) {
+			cout << "Mismatch: " << simdName((simd_t) s) << " on "
+				<< w << "x" << h << endl;
+			failures++;
+		}
+	}
+
+	simdSelect(prev);
+	sigmaSelect(sigma);
+	edgeSelect(slope);
+	blurSelect(blur);
+	cacheSelect(cache);
+
+	failures += verifyKernel<3, char, laplacian>(img, w, h, "laplacian");
+	failures += verifyKernel<5, char, average>(img, w, h, "average");
+	failures += verifyKernel<5, char, lapOfGau>(img, w, h, "lapOfGau");
+	failures += verifyKernel<7, short, lapOfGau7>(img, w, h, "lapOfGau7");
+	failures += verifyKernel<9, short, lapOfGau9>(img, w, h, "lapOfGau9");
+
+	free(expected);
+	free(actual);
+
+	return failures;
+}
+
+int filterRadius() {
+	int radius = unsmoothedRadius();
+
+	return blurSelected() != BLUR_NONE? radius + BLUR_RADIUS : radius;
+}
+
+void tileOrigin(int x, int y) {
+	originX = x;
+	originY = y;
+}
+
+void tileOriginOf(int *x, int *y) {
+	*x = originX;
+	*y = originY;
+}
+
+int tileCount(int w, int h, int tw, int th) {
+	int cols = (originX % tw + w + tw - 1) / tw;
+	int rows = (originY % th + h + th - 1) / th;
+
+	return cols * rows;
+}
+
+void tileBounds(int t, int w, int h, int *x0, int *y0, int *x1, int *y1,
+	int tw, int th) {
+	int ox = originX % tw, oy = originY % th;
+	int cols = (ox + w + tw - 1) / tw;
+
+	*x0 = max((t % cols) * tw - ox, 0);
+	*y0 = max((t / cols) * th - oy, 0);
+	*x1 = min((t % cols + 1) * tw - ox, w);
+	*y1 = min((t / cols + 1) * th - oy, h);
+}
+
+int spanCount(int y0, int y1, int th) {
+	if (y1 <= y0) return 0;
+
+	return (y1 - cellStart(y0, originY, th) + th - 1) / th;
+}
+
+void spanBounds(int s, int y0, int y1, int *s0, int *s1, int th) {
+	int first = cellStart(y0, originY, th);
+
+	*s0 = max(first + s * th, y0);
+	*s1 = min(first + (s + 1) * th, y1);
+}
@@ -0,0 +1,165 @@
+/*
+ ============================================================================
+ Name        : convolve_simd.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : SSE2, AVX2 and AVX-512 kernels for the interior of the
+laplacian-of-gaussian, picked at runtime from the CPU features.
+ ============================================================================
+*/
+#include "convolve.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+/* the kernels accumulate in 16-bit lanes and never divide */
+static_assert(lapOfGau.absSum() * 255 <= 32767,
+	"lapOfGau overflows 16-bit lanes");
+static_assert(lapOfGau.sum() == 0,
+	"lapOfGau needs a divide the SIMD kernels do not do");
+
+#ifdef SIMD_X86
+
+static int lapRowSSE2(const uByte *const *rows, uByte *out, int n) {
+	const __m128i zero = _mm_setzero_si128();
+	int x = 0;
+
+	/* 16 pixels per iteration, widened into two registers */
+	for (; x + 16 <= n; x += 16) {
+		__m128i lo = zero;
+		__m128i hi = zero;
+
+		for (int j = 0; j < 5; ++j) {
+			for (int i = 0; i < 5; ++i) {
+				if (!lapOfGau[i][j]) continue;
+
+				__m128i p = _mm_loadu_si128((const __m128i*)
+					(rows[j] + x + i - 2));
+				__m128i k = _mm_set1_epi16(lapOfGau[i][j]);
+
+				lo = _mm_add_epi16(lo,
+					_mm_mullo_epi16(k, _mm_unpacklo_epi8(p, zero)));
+				hi = _mm_add_epi16(hi,
+					_mm_mullo_epi16(k, _mm_unpackhi_epi8(p, zero)));
+			}
+		}
+
+		/* packus clamps to [0, 255] on the way */
+		_mm_storeu_si128((__m128i*) (out + x), _mm_packus_epi16(lo, hi));
+	}
+
+	return x;
+}
+
+__attribute__((target("avx2")))
+static int lapRowAVX2(const uByte *const *rows, uByte *out, int n) {
+	int x = 0;
+
+	/* 32 pixels per iteration, widened into two registers */
+	for (; x + 32 <= n; x += 32) {
+		__m256i lo = _mm256_setzero_si256();
+		__m256i hi = _mm256_setzero_si256();
+
+		for (int j = 0; j < 5; ++j) {
+			for (int i = 0; i < 5; ++i) {
+				if (!lapOfGau[i][j]) continue;
+
+				const uByte *p = rows[j] + x + i - 2;
+				__m256i k = _mm256_set1_epi16(lapOfGau[i][j]);
+
+				lo = _mm256_add_epi16(lo, _mm256_mullo_epi16(k,
+					_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) p))));
+				hi = _mm256_add_epi16(hi, _mm256_mullo_epi16(k,
+					_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) (p + 16)))));
+			}
+		}
+
+		/* packus clamps to [0, 255] but works per 128-bit lane, put the
+		 * quadwords back in order */
+		_mm256_storeu_si256((__m256i*) (out + x),
+			_mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8));
+	}
+
+	return x;
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static int lapRowAVX512(const uByte *const *rows, uByte *out, int n) {
+	int x = 0;
+
+	/* 32 pixels per iteration */
+	for (; x + 32 <= n; x += 32) {
+		__m512i sum = _mm512_setzero_si512();
+
+		for (int j = 0; j < 5; ++j) {
+			for (int i = 0; i < 5; ++i) {
+				if (!lapOfGau[i][j]) continue;
+
+				const uByte *p = rows[j] + x + i - 2;
+
+				sum = _mm512_add_epi16(sum, _mm512_mullo_epi16(
+					_mm512_set1_epi16(lapOfGau[i][j]),
+					_mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i*) p))));
+			}
+		}
+
+		sum = _mm512_min_epi16(_mm512_max_epi16(sum, _mm512_setzero_si512()),
+			_mm512_set1_epi16(255));
+
+		_mm256_storeu_si256((__m256i*) (out + x), _mm512_cvtepi16_epi8(sum));
+	}
+
+	return x;
+}
+
+#endif /* SIMD_X86 */
+
+static simd_t selected = simdDetect();
+
+simd_t simdDetect() {
+#ifdef SIMD_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+		return SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return SIMD_AVX2;
+	if (__builtin_cpu_supports("sse2"))
+		return SIMD_SSE2;
+#endif
+
+	return SIMD_NONE;
+}
+
+void simdSelect(simd_t simd) {
+	selected = simd;
+}
+
+simd_t simdSelected() {
+	return selected;
+}
+
+const char* simdName(simd_t simd) {
+	switch (simd) {
+	case SIMD_SSE2: return "sse2";
+	case SIMD_AVX2: return "avx2";
+	case SIMD_AVX512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+simd_row_fn simdRow(simd_t simd) {
+#ifdef SIMD_X86
+	switch (simd) {
+	case SIMD_SSE2: return lapRowSSE2;
+	case SIMD_AVX2: return lapRowAVX2;
+	case SIMD_AVX512: return lapRowAVX512;
+	default: break;
+	}
+#endif
+
+	return NULL;
+}
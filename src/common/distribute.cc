@@ -0,0 +1,752 @@
+/*
+ ============================================================================
+ Name        : distribute.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Splits an image over MPI processes, in bands of rows or in
+blocks of a process grid, and joins the results.
+ ============================================================================
+*/
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "distribute.h"
+#include "mapped.h"
+#include "timing.h"
+#include "buffers.h"
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+
+int gridOf(int p, const options *opts, int *rows, int *cols) {
+	if (opts->gridRows == 0) {
+		*rows = p;
+		*cols = 1;
+
+		return 0;
+	}
+
+	*rows = opts->gridRows;
+	*cols = opts->gridCols;
+
+	return *rows * *cols == p? 0 : -1;
+}
+
+void blockBounds(int r, int w, int h, int rows, int cols,
+	int *x0, int *y0, int *x1, int *y1) {
+	int row = r / cols, col = r % cols;
+
+	/* the remainders spread over the first rows and columns of the grid */
+	*x0 = (long) w * col / cols;
+	*x1 = (long) w * (col + 1) / cols;
+	*y0 = (long) h * row / rows;
+	*y1 = (long) h * (row + 1) / rows;
+}
+
+/* rows [y, y + bh) and columns [x, x + bw) of an h x w buffer */
+static MPI_Datatype blockType(int h, int w, int y, int x, int bh, int bw) {
+	int sizes[2] = {h, w}, subsizes[2] = {bh, bw}, starts[2] = {y, x};
+	MPI_Datatype type;
+
+	MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C,
+		MPI_UNSIGNED_CHAR, &type);
+	MPI_Type_commit(&type);
+
+	return type;
+}
+
+/* sends the bh x bw block at (sx, sy) of an h x w buffer to dest while
+ * receiving the one at (rx, ry) from source. either may be MPI_PROC_NULL,
+ * in which case its block may lie outside the buffer */
+static void swapHalo(uByte *buf, int h, int w, int bh, int bw,
+	int sy, int sx, int dest, int ry, int rx, int source, int tag,
+	MPI_Comm comm) {
+	MPI_Datatype sendType = MPI_BYTE, recvType = MPI_BYTE;
+	int sendCount = 0, recvCount = 0;
+
+	if (dest != MPI_PROC_NULL) {
+		sendType = blockType(h, w, sy, sx, bh, bw);
+		sendCount = 1;
+	}
+
+	if (source != MPI_PROC_NULL) {
+		recvType = blockType(h, w, ry, rx, bh, bw);
+		recvCount = 1;
+	}
+
+	MPI_Sendrecv(buf, sendCount, sendType, dest, tag,
+		buf, recvCount, recvType, source, tag, comm, MPI_STATUS_IGNORE);
+
+	if (sendCount) MPI_Type_free(&sendType);
+	if (recvCount) MPI_Type_free(&recvType);
+}
+
+/* moves the tile origin of convolve.h by (x, y), to the first pixel of
+ * the part of the image this process filters, so that its tiles line up
+ * with those of the whole image. (-x, -y) moves it back */
+static void shiftOrigin(int x, int y) {
+	int ox, oy;
+
+	tileOriginOf(&ox, &oy);
+	tileOrigin(ox + x, oy + y);
+}
+
+/* the whole image on rank 0, for images too small to be split */
+static int filterAlone(image *img, int w, int h, const options *opts,
+	MPI_Comm comm, const backend *threads) {
+	int rank;
+
+	MPI_Comm_rank(comm, &rank);
+	enterPhase(PHASE_FILTER);
+
+	if (rank == 0) threads->filter(img->data, w, h, opts);
+
+	return 0;
+}
+
+/* bands of whole rows, each one contiguous, so they go out and come back
+ * in single collectives */
+static int filterBands(image *img, int w, int h, const options *opts,
+	MPI_Comm comm, const backend *threads) {
+	int rank, p;
+	int x0, y0, x1, y1;
+	int halo = filterRadius();
+	MPI_Datatype rowType; /* one row of the image */
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+
+	int counts[p], displs[p]; /* rows and first row of each process */
+
+	for (int i = 0; i < p; ++i) {
+		blockBounds(i, w, h, p, 1, &x0, &y0, &x1, &y1);
+
+		counts[i] = y1 - y0;
+		displs[i] = y0;
+	}
+
+	int height = counts[rank];
+
+	enterPhase(PHASE_SCATTER);
+
+	/* room for the halo rows of the neighbours */
+	int top = rank > 0? halo : 0;
+	int bottom = rank < p - 1? halo : 0;
+
+	image *band = NULL;
+	uByte *mat;
+
+	/* rank 0 filters its rows where they are */
+	if (rank == 0) {
+		mat = img->data;
+	} else {
+		band = newImage(w, top + height + bottom);
+		mat = band->data;
+
+		if (threads->touch) threads->touch(mat, w, top + height + bottom, opts);
+	}
+
+	MPI_Type_contiguous(w, MPI_UNSIGNED_CHAR, &rowType);
+	MPI_Type_commit(&rowType);
+
+	/* each process gets only its own rows */
+	MPI_Scatterv(rank == 0? img->data : NULL, counts, displs, rowType,
+		rank == 0? MPI_IN_PLACE : mat + top * w, height, rowType, 0, comm);
+
+	/* the first rows of this band go up as the rows below the band above,
+	 * and the last rows go down as the rows above the band below */
+	int up = rank > 0? rank - 1 : MPI_PROC_NULL;
+	int down = rank < p - 1? rank + 1 : MPI_PROC_NULL;
+	uByte *own = mat + top * w;
+
+	MPI_Sendrecv(own, halo, rowType, up, 6,
+		own + (long) height * w, halo, rowType, down, 6,
+		comm, MPI_STATUS_IGNORE);
+	MPI_Sendrecv(own + (long) (height - halo) * w, halo, rowType, down, 7,
+		mat, halo, rowType, up, 7, comm, MPI_STATUS_IGNORE);
+
+	enterPhase(PHASE_FILTER);
+	shiftOrigin(0, displs[rank] - top);
+	threads->filter(mat, w, top + height + bottom, opts);
+	shiftOrigin(0, top - displs[rank]);
+	enterPhase(PHASE_GATHER);
+
+	/* the results land straight in img */
+	MPI_Gatherv(rank == 0? MPI_IN_PLACE : own, height, rowType,
+		rank == 0? img->data : NULL, counts, displs, rowType, 0, comm);
+
+	MPI_Type_free(&rowType);
+	deleteImage(band);
+
+	return 0;
+}
+
+/* blocks of a rows x cols grid. halos are swapped with the left and right
+ * neighbours first, then with the ones above and below including the
+ * columns just received, which fills the corners */
+static int filterBlocks(image *img, int w, int h, int rows, int cols,
+	const options *opts, MPI_Comm comm, const backend *threads) {
+	int rank, p;
+	int x0, y0, x1, y1;
+	int halo = filterRadius();
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+
+	int row = rank / cols, col = rank % cols;
+
+	blockBounds(rank, w, h, rows, cols, &x0, &y0, &x1, &y1);
+
+	int bw = x1 - x0, bh = y1 - y0;
+
+	/* room for the halos of the neighbours */
+	int top = row > 0? halo : 0;
+	int bottom = row < rows - 1? halo : 0;
+	int left = col > 0? halo : 0;
+	int right = col < cols - 1? halo : 0;
+
+	int lw = left + bw + right, lh = top + bh + bottom;
+
+	enterPhase(PHASE_SCATTER);
+
+	image *block = newImage(lw, lh);
+	MPI_Datatype ownType = blockType(lh, lw, top, left, bh, bw);
+	MPI_Request reqs[p];
+
+	if (threads->touch) threads->touch(block->data, lw, lh, opts);
+
+	/* rank 0 sends every block straight out of img */
+	if (rank == 0) {
+		for (int r = 0; r < p; ++r) {
+			int rx0, ry0, rx1, ry1;
+
+			blockBounds(r, w, h, rows, cols, &rx0, &ry0, &rx1, &ry1);
+
+			MPI_Datatype type = blockType(h, w, ry0, rx0, ry1 - ry0, rx1 - rx0);
+			MPI_Isend(img->data, 1, type, r, 2, comm, &reqs[r]);
+			MPI_Type_free(&type);
+		}
+	}
+
+	MPI_Recv(block->data, 1, ownType, 0, 2, comm, MPI_STATUS_IGNORE);
+
+	if (rank == 0) MPI_Waitall(p, reqs, MPI_STATUSES_IGNORE);
+
+	int up = row > 0? rank - cols : MPI_PROC_NULL;
+	int down = row < rows - 1? rank + cols : MPI_PROC_NULL;
+	int west = col > 0? rank - 1 : MPI_PROC_NULL;
+	int east = col < cols - 1? rank + 1 : MPI_PROC_NULL;
+
+	/* columns, on the rows of this block only */
+	swapHalo(block->data, lh, lw, bh, halo, top, left, west,
+		top, left + bw, east, 6, comm);
+	swapHalo(block->data, lh, lw, bh, halo, top, left + bw - halo, east,
+		top, 0, west, 7, comm);
+
+	/* rows, across the whole width of the block and its halos */
+	swapHalo(block->data, lh, lw, halo, lw, top, 0, up,
+		top + bh, 0, down, 8, comm);
+	swapHalo(block->data, lh, lw, halo, lw, top + bh - halo, 0, down,
+		0, 0, up, 9, comm);
+
+	enterPhase(PHASE_FILTER);
+	shiftOrigin(x0 - left, y0 - top);
+	threads->filter(block->data, lw, lh, opts);
+	shiftOrigin(left - x0, top - y0);
+	enterPhase(PHASE_GATHER);
+
+	/* the results land straight in img */
+	if (rank == 0) {
+		for (int r = 0; r < p; ++r) {
+			int rx0, ry0, rx1, ry1;
+
+			blockBounds(r, w, h, rows, cols, &rx0, &ry0, &rx1, &ry1);
+
+			MPI_Datatype type = blockType(h, w, ry0, rx0, ry1 - ry0, rx1 - rx0);
+			MPI_Irecv(img->data, 1, type, r, 3, comm, &reqs[r]);
+			MPI_Type_free(&type);
+		}
+	}
+
+	MPI_Send(block->data, 1, ownType, 0, 3, comm);
+
+	if (rank == 0) MPI_Waitall(p, reqs, MPI_STATUSES_IGNORE);
+
+	MPI_Type_free(&ownType);
+	deleteImage(block);
+
+	return 0;
+}
+
+/* spans of rows [starts[i], ends[i]) of an h-row band, in the order they
+ * can be filtered when its rows arrive in chunks of chunk rows: as soon as
+ * the halo rows below are in, and the rows next to a halo once both halos 
+ * are. inside the band they end between the chunk-high tiles of the
+ * image, row first of which the band starts at, so that they cut none of
+ * them. returns how many there are, at most h / chunk + 3 */
+static int pipelineSpans(int h, int chunk, int halo, bool top, bool bottom,
+	int first, int *starts, int *ends) {
+	int lo = min(top? halo : 0, h); /* first row not needing the top halo */
+	int hi = max(bottom? h - halo : h, lo); /* nor the bottom one */
+	int done, n = 0;
+
+	/* out to the tiles they fall in */
+	if (lo > 0) lo = min(lo + (chunk - (first + lo) % chunk) % chunk, h);
+	if (hi < h) hi = max(hi - (first + hi) % chunk, lo);
+
+	done = lo;
+
+	for (int y = 0; y < h; y += chunk) {
+		int avail = min(y + chunk, h);
+		int next = min(avail == h? hi : avail - halo, hi);
+
+		if (next < hi) next -= (first + next) % chunk;
+
+		if (next > done) {
+			starts[n] = done;
+			ends[n++] = next;
+			done = next;
+		}
+	}
+
+	if (lo > 0) {
+		starts[n] = 0;
+		ends[n++] = lo;
+	}
+
+	if (hi < h) {
+		starts[n] = hi;
+		ends[n++] = h;
+	}
+
+	return n;
+}
+
+/* bands sent in chunks, with the halos straight from rank 0 behind them.
+ * every process filters the rows whose neighbourhood has arrived while
+ * later chunks are in flight, sends the results back at once and does the
+ * rows next to the halos last. rank 0 filters its own band while its
+ * sends go out */
+static int pipelineBands(image *img, int w, int h, const options *opts,
+	MPI_Comm comm, const backend *threads) {
+	int rank, p;
+	int x0, y0, x1, y1;
+	int ox, oy; /* tile origin of the image */
+	int chunk = opts->tileHeight;
+	int halo = filterRadius();
+	MPI_Datatype rowType; /* one row of the image */
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+	tileOriginOf(&ox, &oy);
+
+	MPI_Type_contiguous(w, MPI_UNSIGNED_CHAR, &rowType);
+	MPI_Type_commit(&rowType);
+
+	blockBounds(rank, w, h, p, 1, &x0, &y0, &x1, &y1);
+
+	int height = y1 - y0;
+	int top = rank > 0? halo : 0;
+	int bottom = rank < p - 1? halo : 0;
+	int maxSpans = height / chunk + 3;
+
+	/* phases interleave here: each one is charged while it holds things up */
+	enterPhase(PHASE_SCATTER);
+
+	if (rank == 0) {
+		int maxReqs = (h / chunk + p * 3) * 2;
+		MPI_Request *reqs = (MPI_Request*) malloc(sizeof(MPI_Request) * 
+			maxReqs);
+		int n = 0;
+
+		/* chunks, then halos, of every other band */
+		for (int r = 1; r < p; ++r) {
+			blockBounds(r, w, h, p, 1, &x0, &y0, &x1, &y1);
+
+			for (int y = y0; y < y1; y += chunk) {
+				MPI_Isend(img->data + (long) y * w, min(chunk, y1 - y), rowType,
+					r, 2, comm, &reqs[n++]);
+			}
+
+			MPI_Isend(img->data + (long) (y0 - halo) * w, halo, rowType,
+				r, 4, comm, &reqs[n++]);
+
+			if (r < p - 1) {
+				MPI_Isend(img->data + (long) y1 * w, halo, rowType,
+					r, 5, comm, &reqs[n++]);
+			}
+		}
+
+		/* rank 0 filters its own band while those go out */
+		uByte *out = (uByte*) takeBuffer(sizeof(uByte) * (long) height * w);
+
+		enterPhase(PHASE_FILTER);
+		threads->rows(img->data, out, w, height + bottom, 0, height, opts);
+		enterPhase(PHASE_SCATTER);
+
+		/* nothing lands in img before it has all been sent */
+		MPI_Waitall(n, reqs, MPI_STATUSES_IGNORE);
+		enterPhase(PHASE_GATHER);
+
+		memcpy(img->data, out, sizeof(uByte) * height * w);
+		giveBuffer(out);
+
+		n = 0;
+
+		int *starts = (int*) malloc(sizeof(int) * (h / chunk + 3));
+		int *ends = (int*) malloc(sizeof(int) * (h / chunk + 3));
+
+		/* the spans every band sends back, in the order it sends them */
+		for (int r = 1; r < p; ++r) {
+			blockBounds(r, w, h, p, 1, &x0, &y0, &x1, &y1);
+
+			int spans = pipelineSpans(y1 - y0, chunk, halo, true, r < p - 1,
+				oy + y0, starts, ends);
+
+			for (int s = 0; s < spans; ++s) {
+				MPI_Irecv(img->data + (long) (y0 + starts[s]) * w,
+					ends[s] - starts[s], rowType, r, 3, comm, &reqs[n++]);
+			}
+		}
+
+		MPI_Waitall(n, reqs, MPI_STATUSES_IGNORE);
+
+		free(starts);
+		free(ends);
+		free(reqs);
+	} else {
+		int chunks = (height + chunk - 1) / chunk;
+		MPI_Request *recvs = (MPI_Request*) malloc(sizeof(MPI_Request) * 
+			(chunks + 2));
+		MPI_Request *sends = (MPI_Request*) malloc(sizeof(MPI_Request) * maxSpans);
+		int *starts = (int*) malloc(sizeof(int) * maxSpans);
+		int *ends = (int*) malloc(sizeof(int) * maxSpans);
+		int spans = pipelineSpans(height, chunk, halo, true, bottom > 0,
+			oy + y0, starts, ends);
+		int sent = 0;
+
+		image *band = newImage(w, top + height + bottom);
+		uByte *out = (uByte*) takeBuffer(sizeof(uByte) * (long) height * w);
+
+		if (threads->touch) {
+			threads->touch(band->data, w, top + height + bottom, opts);
+			threads->touch(out, w, height, opts);
+		}
+
+		for (int c = 0; c < chunks; ++c) {
+			int y = c * chunk;
+
+			MPI_Irecv(band->data + (long) (top + y) * w, 
+				min(chunk, height - y), rowType, 0, 2, comm, &recvs[c]);
+		}
+
+		MPI_Irecv(band->data, halo, rowType, 0, 4, comm, &recvs[chunks]);
+		recvs[chunks + 1] = MPI_REQUEST_NULL;
+
+		if (bottom) {
+			MPI_Irecv(band->data + (long) (top + height) * w, halo, rowType,
+				0, 5, comm, &recvs[chunks + 1]);
+		}
+
+		shiftOrigin(0, y0 - top);
+
+		/* the spans in the order pipelineSpans gives them, each one as soon
+		 * as the chunk it waits for is in */
+		for (int c = 0; c < chunks && sent < spans; ++c) {
+			int avail = min((c + 1) * chunk, height);
+			int ready = avail == height && !bottom? height : avail - halo;
+
+			enterPhase(PHASE_SCATTER);
+			MPI_Wait(&recvs[c], MPI_STATUS_IGNORE);
+			enterPhase(PHASE_FILTER);
+
+			/* not the span next to the top halo, which comes last */
+			while (sent < spans && starts[sent] > 0 && ends[sent] <= ready) {
+				threads->rows(band->data, out + (long) starts[sent] * w, w,
+					top + height + bottom, top + starts[sent], top + ends[sent], opts);
+				MPI_Isend(out + (long) starts[sent] * w, ends[sent] - starts[sent],
+					rowType, 0, 3, comm, &sends[sent]);
+				sent++;
+			}
+		}
+
+		/* the rows next to the halos */
+		enterPhase(PHASE_SCATTER);
+		MPI_Waitall(chunks + 2, recvs, MPI_STATUSES_IGNORE);
+		enterPhase(PHASE_FILTER);
+
+		for (; sent < spans; ++sent) {
+			threads->rows(band->data, out + (long) starts[sent] * w, w,
+				top + height + bottom, top + starts[sent], top + ends[sent], opts);
+			MPI_Isend(out + (long) starts[sent] * w, ends[sent] - starts[sent],
+				rowType, 0, 3, comm, &sends[sent]);
+		}
+
+		shiftOrigin(0, top - y0);
+		enterPhase(PHASE_GATHER);
+		MPI_Waitall(spans, sends, MPI_STATUSES_IGNORE);
+
+		deleteImage(band);
+		giveBuffer(out);
+		free(recvs);
+		free(sends);
+		free(starts);
+		free(ends);
+	}
+
+	MPI_Type_free(&rowType);
+
+	return 0;
+}
+
+/* bands per node rather than per process. the node leaders split the image
+ * and swap halos over comm, and the processes of a node filter parts of 
+ * their node's band straight out of one shared window, so nothing moves
+ * between processes on the same node */
+static int hybridBands(image *img, int w, int h, const options *opts,
+	MPI_Comm comm, const backend *threads) {
+	int rank, nodeRank, q;
+	int x0, y0, x1, y1;
+	int halo = filterRadius();
+	int node[2]; /* index of this node and number of nodes */
+	MPI_Comm local, leaders;
+	MPI_Datatype rowType; /* one row of the image */
+	MPI_Win win;
+	uByte *base;
+
+	MPI_Comm_rank(comm, &rank);
+
+	enterPhase(PHASE_SCATTER);
+
+	/* the processes sharing memory, and one leader of each node */
+	MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+		&local);
+	MPI_Comm_rank(local, &nodeRank);
+	MPI_Comm_size(local, &q);
+
+	MPI_Comm_split(comm, nodeRank == 0? 0 : MPI_UNDEFINED, rank, &leaders);
+
+	if (nodeRank == 0) {
+		MPI_Comm_rank(leaders, &node[0]);
+		MPI_Comm_size(leaders, &node[1]);
+	}
+
+	MPI_Bcast(node, 2, MPI_INT, 0, local);
+
+	/* node bands swap their edge rows as halos, so with more than one node
+	 * each one needs that many rows */
+	if (node[1] > 1 && h / node[1] < halo) {
+		if (nodeRank == 0) MPI_Comm_free(&leaders);
+		MPI_Comm_free(&local);
+
+		return filterAlone(img, w, h, opts, comm, threads);
+	}
+
+	blockBounds(node[0], w, h, node[1], 1, &x0, &y0, &x1, &y1);
+
+	int height = y1 - y0;
+	int top = node[0] > 0? halo : 0;
+	int bottom = node[0] < node[1] - 1? halo : 0;
+	int rows = top + height + bottom;
+
+	/* the band of the node with its halos, then its results */
+	MPI_Win_allocate_shared(nodeRank == 0? (MPI_Aint) 2 * rows * w : 0, 1,
+		MPI_INFO_NULL, local, &base, &win);
+
+	if (nodeRank != 0) {
+		MPI_Aint size;
+		int unit;
+
+		MPI_Win_shared_query(win, 0, &size, &unit, &base);
+	}
+
+	uByte *band = base, *out = base + (long) rows * w;
+
+	MPI_Type_contiguous(w, MPI_UNSIGNED_CHAR, &rowType);
+	MPI_Type_commit(&rowType);
+
+	MPI_Win_fence(0, win);
+
+	/* only the leaders talk across nodes */
+	if (nodeRank == 0) {
+		int p = node[1];
+		int counts[p], displs[p]; /* rows and first row of each node */
+
+		for (int i = 0; i < p; ++i) {
+			blockBounds(i, w, h, p, 1, &x0, &y0, &x1, &y1);
+
+			counts[i] = y1 - y0;
+			displs[i] = y0;
+		}
+
+		MPI_Scatterv(rank == 0? img->data : NULL, counts, displs, rowType,
+			band + top * w, height, rowType, 0, leaders);
+
+		int up = node[0] > 0? node[0] - 1 : MPI_PROC_NULL;
+		int down = node[0] < p - 1? node[0] + 1 : MPI_PROC_NULL;
+		uByte *own = band + top * w;
+
+		MPI_Sendrecv(own, halo, rowType, up, 6,
+			own + (long) height * w, halo, rowType, down, 6,
+			leaders, MPI_STATUS_IGNORE);
+		MPI_Sendrecv(own + (long) (height - halo) * w, halo, rowType, down, 7,
+			band, halo, rowType, up, 7, leaders, MPI_STATUS_IGNORE);
+	}
+
+	MPI_Win_fence(0, win);
+
+	/* row of the image the band of the node starts at, with its halo */
+	int first = y0 - top;
+
+	/* each process of the node takes a part of its band */
+	blockBounds(nodeRank, w, height, q, 1, &x0, &y0, &x1, &y1);
+
+	enterPhase(PHASE_FILTER);
+
+	if (y1 > y0) {
+		shiftOrigin(0, first);
+		threads->rows(band, out + (long) y0 * w, w, rows, top + y0, top + y1,
+			opts);
+		shiftOrigin(0, -first);
+	}
+
+	/* waiting for the rest of the node counts as gathering */
+	enterPhase(PHASE_GATHER);
+	MPI_Win_fence(0, win);
+
+	/* the results land straight in img */
+	if (nodeRank == 0) {
+		int p = node[1];
+		int counts[p], displs[p];
+
+		for (int i = 0; i < p; ++i) {
+			blockBounds(i, w, h, p, 1, &x0, &y0, &x1, &y1);
+
+			counts[i] = y1 - y0;
+			displs[i] = y0;
+		}
+
+		MPI_Gatherv(out, height, rowType, rank == 0? img->data : NULL,
+			counts, displs, rowType, 0, leaders);
+
+		MPI_Comm_free(&leaders);
+	}
+
+	MPI_Type_free(&rowType);
+	MPI_Win_free(&win);
+	MPI_Comm_free(&local);
+
+	return 0;
+}
+
+int distribute(image *img, int w, int h, const options *opts, MPI_Comm comm,
+	const backend *threads) {
+	int rank, p, rows, cols;
+	int halo = filterRadius();
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+
+	if (gridOf(p, opts, &rows, &cols) != 0) {
+		if (rank == 0)
+			cout << "Error: a " << rows << "x" << cols << " grid needs "
+				<< rows * cols << " processes, not " << p << "." << endl;
+
+		return -1;
+	}
+
+	if (opts->hybrid)
+		return hybridBands(img, w, h, opts, comm, threads);
+
+	/* blocks swap their edge rows and columns as halos, so each one needs
+	 * that many of them on the sides that have a neighbour */
+	if ((rows > 1 && h / rows < halo) || (cols > 1 && w / cols < halo))
+		return filterAlone(img, w, h, opts, comm, threads);
+
+	if (cols == 1 && opts->pipeline)
+		return pipelineBands(img, w, h, opts, comm, threads);
+
+	if (cols == 1)
+		return filterBands(img, w, h, opts, comm, threads);
+
+	return filterBlocks(img, w, h, rows, cols, opts, comm, threads);
+}
+
+int distributeMapped(const options *opts, MPI_Comm comm,
+	const backend *threads, int count) {
+	int w = opts->rawWidth, h = opts->rawHeight;
+	int rank, p, result;
+	int x0, y0, x1, y1;
+	format_t outFormat = formatOf(opts->output);
+	long inOffset, outOffset = -1;
+	double start_t;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+
+	if (outFormat == FORMAT_PNG) {
+		if (rank == 0)
+			cout << "Error: mapped images are written as .pgm or .raw." << endl;
+
+		return -1;
+	}
+
+	enterPhase(PHASE_DECODE);
+
+	inOffset = readHeader(opts->input, formatOf(opts->input), &w, &h);
+
+	if (inOffset < 0) return -1;
+
+	/* rank 0 sizes the output, then every rank maps its rows of it */
+	if (rank == 0)
+		outOffset = createMapped(opts->output, outFormat, w, h);
+
+	MPI_Bcast(&outOffset, 1, MPI_LONG, 0, comm);
+
+	if (outOffset < 0) return -1;
+
+	blockBounds(rank, w, h, p, 1, &x0, &y0, &x1, &y1);
+
+	int haloY0 = max(y0 - filterRadius(), 0);
+	int haloY1 = min(y1 + filterRadius(), h);
+
+	image *in = mapRows(opts->input, inOffset, w, haloY0, haloY1, false);
+	image *out = mapRows(opts->output, outOffset, w, y0, y1, true);
+
+	result = in && out? 0 : -1;
+
+	if (rank == 0) {
+		cout << "# of processes: " << p << endl;
+		cout << "Slice size: w = " << w << "; h = " << y1 - y0 << endl;
+	}
+
+	start_t = MPI_Wtime();
+	enterPhase(PHASE_FILTER);
+
+	if (result == 0) {
+		shiftOrigin(0, haloY0);
+		threads->rows(in->data, out->data, w, haloY1 - haloY0, y0 - haloY0,
+			y1 - haloY0, opts);
+		shiftOrigin(0, -haloY0);
+	}
+
+	/* waiting for the slowest band */
+	enterPhase(PHASE_GATHER);
+	MPI_Barrier(comm);
+
+	if (rank == 0)
+		cout << "Time elapsed: " << MPI_Wtime() - start_t << "s" << endl;
+
+	/* the pages written go back to the file */
+	enterPhase(PHASE_ENCODE);
+	deleteImage(in);
+	deleteImage(out);
+
+	if (opts->csv) printPhases(comm, count, w, h);
+
+	return result;
+}
@@ -0,0 +1,123 @@
+/*
+ ============================================================================
+ Name        : edges.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Zero crossings of the laplacian-of-gaussian, found in the
+same pass that filters.
+ ============================================================================
+*/
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "edges.h"
+#include "kernel.h"
+#include "separable.h"
+#include "buffers.h"
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+
+static int selected = -1;
+
+void edgeSelect(int slope) {
+	selected = slope;
+}
+
+int edgeSelected() {
+	return selected;
+}
+
+/* unclamped values of the selected filter at row y, columns [x0, x1) */
+static void signedRow(const uByte *src, int w, int h, int y, int x0, int x1,
+	engine_t engine, int *out) {
+	if (sigmaSelected() > 0) {
+		sigmaSigned(src, w, h, y, x0, x1, engine, out);
+		return;
+	}
+
+	const uByte *rows[5];
+	int ix0 = min(max(x0, 2), x1);
+	int ix1 = max(min(x1, w - 2), ix0);
+
+	kernelRows<5>(src, w, h, y, rows);
+
+	for (int x = x0; x < ix0; ++x)
+		out[x - x0] = taps<5, char, lapOfGau>::clamped(rows, w, x);
+
+	for (int x = ix0; x < ix1; ++x)
+		out[x - x0] = taps<5, char, lapOfGau>::interior(rows, x);
+
+	for (int x = ix1; x < x1; ++x)
+		out[x - x0] = taps<5, char, lapOfGau>::clamped(rows, w, x);
+}
+
+/* whether a pixel of value v, not negative, and a neighbour of value n
+ * lie across a steep enough zero crossing */
+static inline bool crosses(int v, int n) {
+	return n < 0 && v - n >= selected;
+}
+
+void edgeSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	/* one column more on each side, for the horizontal neighbours */
+	int cx0 = max(x0 - 1, 0), cx1 = min(x1 + 1, w), span = cx1 - cx0;
+
+	/* signed values of rows y - 1 to y + 1, row r in r % 3 */
+	int *ring = (int*) scratchBuffer(SCRATCH_EDGES, sizeof(int) * 3 * span);
+
+	for (int y = max(y0 - 1, 0); y < min(y0 + 1, h); ++y)
+		signedRow(src, w, h, y, cx0, cx1, engine, ring + (y % 3) * span);
+
+	for (int y = y0; y < y1; ++y) {
+		if (y + 1 < h)
+			signedRow(src, w, h, y + 1, cx0, cx1, engine,
+				ring + ((y + 1) % 3) * span);
+
+		const int *up = y > 0? ring + ((y - 1) % 3) * span : NULL;
+		const int *mid = ring + (y % 3) * span;
+		const int *down = y + 1 < h? ring + ((y + 1) % 3) * span : NULL;
+		uByte *row = out + (long) (y - y0) * w;
+
+		for (int x = x0; x < x1; ++x) {
+			int c = x - cx0, v = mid[c];
+			bool edge = v >= 0 && (
+				(x > 0 && crosses(v, mid[c - 1])) ||
+				(x < w - 1 && crosses(v, mid[c + 1])) ||
+				(up && crosses(v, up[c])) ||
+				(down && crosses(v, down[c])));
+
+			row[x] = edge? 255 : 0;
+		}
+	}
+}
+
+int verifyEdges(const uByte *img, int w, int h) {
+	uByte *expected = (uByte*) malloc(sizeof(uByte) * w * h);
+	uByte *actual = (uByte*) malloc(sizeof(uByte) * w * h);
+	int tiles = tileCount(w, h, 64, 16);
+	int x0, y0, x1, y1, failures = 0;
+
+	edgeSpan(img, expected, w, h, 0, 0, w, h, ENGINE_SPLIT);
+
+	for (int t = 0; t < tiles; ++t) {
+		tileBounds(t, w, h, &x0, &y0, &x1, &y1, 64, 16);
+		edgeSpan(img, actual + (long) y0 * w, w, h, x0, y0, x1, y1,
+			ENGINE_SPLIT);
+	}
+
+	if (memcmp(expected, actual, sizeof(uByte) * w * h)) {
+		cout << "Mismatch: edges of slope " << selected << " on " << w << "x"
+			<< h << endl;
+		failures++;
+	}
+
+	free(expected);
+	free(actual);
+
+	return failures;
+}
@@ -0,0 +1,87 @@
+/*
+ ============================================================================
+ Name        : farm.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Images of a batch handed out on demand by rank 0 to the
+other MPI processes, which do their own file I/O.
+ ============================================================================
+*/
+#include <iostream>
+#include "farm.h"
+
+using std::cout;
+using std::endl;
+
+/* what workers tell rank 0 */
+#define FARM_ASK 0  /* an image, please */
+#define FARM_DONE 1 /* no more images, with the number of failures */
+
+/* asks rank 0 for the next image, from the decoding thread */
+static int nextFromMaster(void *arg) {
+	MPI_Comm comm = *(MPI_Comm*) arg;
+	int msg[2] = {FARM_ASK, 0};
+	int i;
+
+	MPI_Send(msg, 2, MPI_INT, 0, 10, comm);
+	MPI_Recv(&i, 1, MPI_INT, 0, 11, comm, MPI_STATUS_IGNORE);
+
+	return i;
+}
+
+/* hands out the images in order until every worker is done, and prints
+ * how many each one did */
+static void serve(const options *opts, MPI_Comm comm, int p) {
+	int size = batchSize(opts), next = 0, active = p - 1;
+	int given[p];
+
+	for (int r = 0; r < p; ++r) given[r] = 0;
+
+	while (active > 0) {
+		MPI_Status status;
+		int msg[2];
+
+		MPI_Recv(msg, 2, MPI_INT, MPI_ANY_SOURCE, 10, comm, &status);
+
+		if (msg[0] == FARM_DONE) {
+			active--;
+			continue;
+		}
+
+		int i = next < size? next++ : -1;
+
+		if (i >= 0) given[status.MPI_SOURCE]++;
+
+		MPI_Send(&i, 1, MPI_INT, status.MPI_SOURCE, 11, comm);
+	}
+
+	cout << "Images per process:";
+
+	for (int r = 1; r < p; ++r) cout << " " << given[r];
+
+	cout << endl;
+}
+
+int farmBatch(const options *opts, filter_fn filter, MPI_Comm comm) {
+	int rank, p;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+
+	/* nobody to hand images to */
+	if (p == 1) return filterBatch(opts, filter, 0, 1);
+
+	if (rank == 0) {
+		serve(opts, comm, p);
+
+		return 0;
+	}
+
+	int failures = filterPipeline(opts, filter, nextFromMaster, &comm);
+	int msg[2] = {FARM_DONE, failures};
+
+	MPI_Send(msg, 2, MPI_INT, 0, 10, comm);
+
+	return failures;
+}
@@ -0,0 +1,166 @@
+/*
+ ============================================================================
+ Name        : image.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : 8-bit grayscale image buffers and their exchange with
+PixelLab images.
+ ============================================================================
+*/
+#include <cstdlib>
+#include <sys/mman.h>
+#include "image.h"
+#include "buffers.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+
+image* newImage(int width, int height) {
+	image *img = (image*) malloc(sizeof(image));
+
+	img->width = width;
+	img->height = height;
+	img->data = (uByte*) takeBuffer(sizeof(uByte) * (long) width * height);
+	img->owned = true;
+	img->map = NULL;
+	img->mapSize = 0;
+
+	return img;
+}
+
+image* wrapImage(uByte *data, int width, int height) {
+	image *img = (image*) malloc(sizeof(image));
+
+	img->width = width;
+	img->height = height;
+	img->data = data;
+	img->owned = false;
+	img->map = NULL;
+	img->mapSize = 0;
+
+	return img;
+}
+
+void deleteImage(image *img) {
+	if (!img) return;
+
+	if (img->owned) giveBuffer(img->data);
+	if (img->map) munmap(img->map, img->mapSize);
+	free(img);
+}
+
+#ifdef SIMD_X86
+
+/* whether pshufb can be used to (de)interleave the RGB triplets */
+static bool hasSSSE3() {
+	__builtin_cpu_init();
+
+	return __builtin_cpu_supports("ssse3");
+}
+
+static const bool ssse3 = hasSSSE3();
+
+/* gray values of the first n / 16 * 16 pixels, returns how many it did */
+__attribute__((target("ssse3")))
+static long grayRowSSSE3(const uByte *rgb, uByte *out, long n) {
+	/* where each channel of 16 pixels sits in the 3 loaded vectors */
+	const __m128i ra = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i rb = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+	const __m128i rc = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+	const __m128i ga = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i gb = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+	const __m128i gc = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+	const __m128i ba = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i bb = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+	const __m128i bc = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+	/* s * 21846 >> 16 == s / 3 for every s <= 765 */
+	const __m128i third = _mm_set1_epi16(21846);
+	const __m128i zero = _mm_setzero_si128();
+	long i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i*) (rgb + 3 * i));
+		__m128i b = _mm_loadu_si128((const __m128i*) (rgb + 3 * i + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*) (rgb + 3 * i + 32));
+
+		__m128i r = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, ra),
+			_mm_shuffle_epi8(b, rb)), _mm_shuffle_epi8(c, rc));
+		__m128i g = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, ga),
+			_mm_shuffle_epi8(b, gb)), _mm_shuffle_epi8(c, gc));
+		__m128i bl = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, ba),
+			_mm_shuffle_epi8(b, bb)), _mm_shuffle_epi8(c, bc));
+
+		__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(r, zero),
+			_mm_unpacklo_epi8(g, zero)), _mm_unpacklo_epi8(bl, zero));
+		__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(r, zero),
+			_mm_unpackhi_epi8(g, zero)), _mm_unpackhi_epi8(bl, zero));
+
+		_mm_storeu_si128((__m128i*) (out + i), _mm_packus_epi16(
+			_mm_mulhi_epu16(lo, third), _mm_mulhi_epu16(hi, third)));
+	}
+
+	return i;
+}
+
+/* spreads the first n / 16 * 16 gray values over R, G and B, returns how
+ * many it did */
+__attribute__((target("ssse3")))
+static long rgbRowSSSE3(const uByte *in, uByte *rgb, long n) {
+	const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+	const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+	const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+	long i = 0;
+
+	for (; i + 16 <= n; i += 16) {
+		__m128i g = _mm_loadu_si128((const __m128i*) (in + i));
+
+		_mm_storeu_si128((__m128i*) (rgb + 3 * i), _mm_shuffle_epi8(g, m0));
+		_mm_storeu_si128((__m128i*) (rgb + 3 * i + 16), _mm_shuffle_epi8(g, m1));
+		_mm_storeu_si128((__m128i*) (rgb + 3 * i + 32), _mm_shuffle_epi8(g, m2));
+	}
+
+	return i;
+}
+
+#endif /* SIMD_X86 */
+
+void rgbToGray(const uByte *rgb, uByte *gray, long n) {
+	long i = 0;
+
+#ifdef SIMD_X86
+	if (ssse3) i = grayRowSSSE3(rgb, gray, n);
+#endif
+
+	/* same average as PixelLab::GetGrayValue */
+	for (; i < n; ++i) {
+		gray[i] = (rgb[3 * i] + rgb[3 * i + 1] + rgb[3 * i + 2]) / 3;
+	}
+}
+
+void grayToRgb(const uByte *gray, uByte *rgb, long n) {
+	long i = 0;
+
+#ifdef SIMD_X86
+	if (ssse3) i = rgbRowSSSE3(gray, rgb, n);
+#endif
+
+	/* same as PixelLab::SetGrayValue */
+	for (; i < n; ++i) {
+		rgb[3 * i] = rgb[3 * i + 1] = rgb[3 * i + 2] = gray[i];
+	}
+}
+
+image* ingest(PixelLab *img) {
+	image *gray = newImage(img->GetWidth(), img->GetHeight());
+
+	rgbToGray(img->GetData(), gray->data, (long) gray->width * gray->height);
+
+	return gray;
+}
+
+void egress(const image *gray, PixelLab *img) {
+	grayToRgb(gray->data, img->GetData(), (long) gray->width * gray->height);
+}
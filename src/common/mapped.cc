@@ -0,0 +1,173 @@
+/*
+ ============================================================================
+ Name        : mapped.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Memory-mapped PGM and raw images, which need no decoding.
+ ============================================================================
+*/
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "mapped.h"
+
+using std::cout;
+using std::endl;
+
+format_t formatOf(const char *path) {
+	const char *ext = strrchr(path, '.');
+
+	if (ext && !strcasecmp(ext, ".pgm")) return FORMAT_PGM;
+	if (ext && (!strcasecmp(ext, ".raw") || !strcasecmp(ext, ".gray")))
+		return FORMAT_RAW;
+
+	return FORMAT_PNG;
+}
+
+/* next number of a PGM header, skipping blanks and comments. -1 if none */
+static long pgmNumber(FILE *fp) {
+	int c = fgetc(fp);
+	long n = 0;
+
+	while (c == '#' || isspace(c)) {
+		if (c == '#')
+			while (c != '\n' && c != EOF) c = fgetc(fp);
+
+		c = fgetc(fp);
+	}
+
+	if (!isdigit(c)) return -1;
+
+	for (; isdigit(c); c = fgetc(fp)) n = n * 10 + (c - '0');
+
+	/* the single blank after the number, the pixels follow the last one */
+	if (!isspace(c)) return -1;
+
+	return n;
+}
+
+long readHeader(const char *path, format_t format, int *w, int *h) {
+	FILE *fp = fopen(path, "rb");
+	long offset = 0;
+
+	if (!fp) {
+		cout << "Error: image '" << path << "' not found." << endl;
+		return -1;
+	}
+
+	if (format == FORMAT_PGM) {
+		long width, height, maxval;
+
+		if (fgetc(fp) != 'P' || fgetc(fp) != '5' ||
+			(width = pgmNumber(fp)) <= 0 || (height = pgmNumber(fp)) <= 0 ||
+			(maxval = pgmNumber(fp)) <= 0 || maxval > 255) {
+			cout << "Error: '" << path << "' is not an 8-bit binary PGM." << endl;
+			fclose(fp);
+			return -1;
+		}
+
+		*w = width;
+		*h = height;
+		offset = ftell(fp);
+	}
+
+	/* the pixels must all be there */
+	fseek(fp, 0, SEEK_END);
+
+	if (*w <= 0 || *h <= 0 || ftell(fp) < offset + (long) *w * *h) {
+		cout << "Error: '" << path << "' is smaller than "
+			<< *w << "x" << *h << "." << endl;
+		fclose(fp);
+		return -1;
+	}
+
+	fclose(fp);
+
+	return offset;
+}
+
+long createMapped(const char *path, format_t format, int w, int h) {
+	FILE *fp = fopen(path, "wb");
+	long offset = 0;
+
+	if (!fp) {
+		cout << "Error: cannot write '" << path << "'." << endl;
+		return -1;
+	}
+
+	if (format == FORMAT_PGM) {
+		fprintf(fp, "P5\n%d %d\n255\n", w, h);
+		offset = ftell(fp);
+	}
+
+	fflush(fp);
+
+	/* sized up front, every process then maps and fills its own rows */
+	if (ftruncate(fileno(fp), offset + (long) w * h) != 0) {
+		cout << "Error: cannot write '" << path << "'." << endl;
+		offset = -1;
+	}
+
+	fclose(fp);
+
+	return offset;
+}
+
+image* mapRows(const char *path, long offset, int w, int y0, int y1,
+	bool writable) {
+	/* nothing to map */
+	if (y1 <= y0) return wrapImage(NULL, w, 0);
+
+	int fd = open(path, writable? O_RDWR : O_RDONLY);
+
+	if (fd < 0) {
+		cout << "Error: cannot open '" << path << "'." << endl;
+		return NULL;
+	}
+
+	/* mappings start on a page boundary */
+	long first = offset + (long) y0 * w;
+	long start = first - first % sysconf(_SC_PAGESIZE);
+	long size = first - start + (long) (y1 - y0) * w;
+
+	void *map = mmap(NULL, size, writable? PROT_READ | PROT_WRITE : PROT_READ,
+		writable? MAP_SHARED : MAP_PRIVATE, fd, start);
+
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		cout << "Error: cannot map '" << path << "'." << endl;
+		return NULL;
+	}
+
+	/* rows are read in order */
+	madvise(map, size, MADV_SEQUENTIAL);
+
+	image *img = wrapImage((uByte*) map + (first - start), w, y1 - y0);
+
+	img->map = map;
+	img->mapSize = size;
+
+	return img;
+}
+
+int saveMapped(const image *img, const char *path, format_t format) {
+	long offset = createMapped(path, format, img->width, img->height);
+
+	if (offset < 0) return -1;
+
+	image *out = mapRows(path, offset, img->width, 0, img->height, true);
+
+	if (!out) return -1;
+
+	memcpy(out->data, img->data, (long) img->width * img->height);
+	deleteImage(out);
+
+	return 0;
+}
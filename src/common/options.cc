@@ -0,0 +1,245 @@
+/*
+ ============================================================================
+ Name        : options.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Command line parsing shared by every log-edges binary.
+ ============================================================================
+*/
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include "options.h"
+#include "mapped.h"
+
+using std::cout;
+using std::endl;
+
+int parseOptions(int argc, char *argv[], options *opts) {
+	int c;
+
+	opts->input = NULL;
+	opts->inputs = NULL;
+	opts->inputCount = 0;
+	opts->batchDir = NULL;
+	opts->farm = false;
+	opts->output = "examples/lenaGrayOut.png";
+	opts->engine = ENGINE_SIMD;
+	opts->sigma = 0;
+	opts->slope = -1;
+	opts->blur = BLUR_NONE;
+	opts->verify = false;
+	opts->csv = false;
+	opts->trace = NULL;
+	opts->counters = false;
+	opts->cache = NULL;
+	opts->roiX = opts->roiY = 0;
+	opts->roiWidth = opts->roiHeight = 0;
+	opts->levels = 0;
+	opts->finest = 0;
+	opts->inPlace = false;
+	opts->stream = false;
+	opts->rawWidth = 0;
+	opts->rawHeight = 0;
+	opts->threads = 0;
+	opts->hybrid = false;
+	opts->pipeline = false;
+	opts->gridRows = 0;
+	opts->gridCols = 0;
+	opts->schedule = SCHEDULE_STATIC;
+	opts->tileWidth = TILE_W;
+	opts->tileHeight = TILE_H;
+
+	opterr = 0;
+	optind = 1;
+
+	while ((c = getopt(argc, argv, "b:B:cCe:fg:Hij:k:L:o:p:Pr:R:sS:t:T:Vz:")) != -1) {
+		switch (c) {
+		case 'b':
+			opts->batchDir = optarg;
+			break;
+		case 'B':
+			if (!strcmp(optarg, "average"))
+				opts->blur = BLUR_AVERAGE;
+			else if (!strcmp(optarg, "gaussian"))
+				opts->blur = BLUR_GAUSSIAN;
+			else
+				return -1;
+			break;
+		case 'c':
+			opts->csv = true;
+			break;
+		case 'C':
+			opts->counters = true;
+			break;
+		case 'e':
+			if (!strcmp(optarg, "clamp"))
+				opts->engine = ENGINE_CLAMP;
+			else if (!strcmp(optarg, "split"))
+				opts->engine = ENGINE_SPLIT;
+			else if (!strcmp(optarg, "simd"))
+				opts->engine = ENGINE_SIMD;
+			else
+				return -1;
+			break;
+		case 'f':
+			opts->farm = true;
+			break;
+		case 'g':
+			if (sscanf(optarg, "%dx%d", &opts->gridRows, &opts->gridCols) != 2 ||
+				opts->gridRows < 1 || opts->gridCols < 1)
+				return -1;
+			break;
+		case 'H':
+			opts->hybrid = true;
+			break;
+		case 'i':
+			opts->inPlace = true;
+			break;
+		case 'j':
+			opts->trace = optarg;
+			break;
+		case 'k':
+			opts->cache = optarg;
+			break;
+		case 'L':
+			if (sscanf(optarg, "%lf", &opts->sigma) != 1 || opts->sigma < 1)
+				return -1;
+			break;
+		case 'o':
+			opts->output = optarg;
+			break;
+		case 'p':
+			if (sscanf(optarg, "%d:%d", &opts->levels, &opts->finest) < 1 ||
+				opts->levels < 1 || opts->finest < 0 ||
+				opts->finest >= opts->levels)
+				return -1;
+			break;
+		case 'P':
+			opts->pipeline = true;
+			break;
+		case 'r':
+			if (sscanf(optarg, "%dx%d", &opts->rawWidth, &opts->rawHeight) != 2)
+				return -1;
+			break;
+		case 'R':
+			if (sscanf(optarg, "%dx%d+%d+%d", &opts->roiWidth, &opts->roiHeight,
+				&opts->roiX, &opts->roiY) != 4 || opts->roiWidth < 1 ||
+				opts->roiHeight < 1 || opts->roiX < 0 || opts->roiY < 0)
+				return -1;
+			break;
+		case 's':
+			opts->stream = true;
+			break;
+		case 'S':
+			if (!strcmp(optarg, "static"))
+				opts->schedule = SCHEDULE_STATIC;
+			else if (!strcmp(optarg, "dynamic"))
+				opts->schedule = SCHEDULE_DYNAMIC;
+			else if (!strcmp(optarg, "guided"))
+				opts->schedule = SCHEDULE_GUIDED;
+			else
+				return -1;
+			break;
+		case 't':
+			if (sscanf(optarg, "%d", &opts->threads) != 1 || opts->threads < 1)
+				return -1;
+			break;
+		case 'T':
+			if (sscanf(optarg, "%dx%d", &opts->tileWidth, &opts->tileHeight) != 2 ||
+				opts->tileWidth < 1 || opts->tileHeight < 1)
+				return -1;
+			break;
+		case 'V':
+			opts->verify = true;
+			break;
+		case 'z':
+			if (sscanf(optarg, "%d", &opts->slope) != 1 || opts->slope < 0)
+				return -1;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	/* in place and streaming keep just the 5 rows lapOfGau reads */
+	if ((opts->sigma > 0 || opts->slope >= 0 || opts->blur != BLUR_NONE) &&
+		(opts->inPlace || opts->stream))
+		return -1;
+
+	/* nor do they go through the tiles the cache keeps */
+	if (opts->cache && (opts->inPlace || opts->stream)) return -1;
+
+	/* streaming goes through one image, not a batch */
+	if (opts->stream && opts->batchDir) return -1;
+
+	/* a window or a pyramid of one image, not both */
+	if ((opts->roiWidth || opts->levels) && (opts->batchDir || opts->stream ||
+		opts->verify || (opts->roiWidth && opts->levels)))
+		return -1;
+
+	/* node bands are split by nodes, one window each, not by a grid or in
+	 * chunks */
+	if (opts->hybrid && (opts->gridRows || opts->pipeline)) return -1;
+
+	/* counters go in the trace */
+	if (opts->counters && !opts->trace) return -1;
+
+	/* exactly one image path, or any number of them in batch mode */
+	if (optind == argc) return -1;
+	if (!opts->batchDir && optind != argc - 1) return -1;
+
+	opts->input = argv[optind];
+	opts->inputs = argv + optind;
+	opts->inputCount = argc - optind;
+
+	/* a whole PGM or raw image is filtered straight from its mapping into
+	 * another, in a band of rows per process */
+	if (formatOf(opts->input) != FORMAT_PNG && !opts->batchDir &&
+		!opts->roiWidth && !opts->levels && (opts->inPlace || opts->gridRows ||
+		opts->pipeline || opts->hybrid))
+		return -1;
+
+	return 0;
+}
+
+void printUsage(const char *prog) {
+	cout << "Usage: " << prog << " [options] (image path)" << endl;
+	cout << "       " << prog << " [options] -b dir (image paths or directories)" << endl;
+	cout << "  -b dir               decode, filter and encode many images at once into dir" << endl;
+	cout << "  -B average|gaussian  smooth noisy images first, tile by tile in the same pass" << endl;
+	cout << "  -c                   print the time of each phase as a CSV row (see bench/)" << endl;
+	cout << "  -C                   with -j, cycles and last-level cache misses of each event" << endl;
+	cout << "  -e clamp|split|simd  convolution engine (default: simd)" << endl;
+	cout << "  -f                   with -b, rank 0 hands images out to whichever process is free," << endl;
+	cout << "                       filtering none itself" << endl;
+	cout << "  -g RxC               split over an R x C grid of processes (default: Px1)" << endl;
+	cout << "  -H                   one band per node, shared by its processes, not with -g or -P" << endl;
+	cout << "  -i                   filter in place, keeping only a few rows of history" << endl;
+	cout << "  -j path              write a Chrome trace of the phases of every process and" << endl;
+	cout << "                       the tiles of every thread to path" << endl;
+	cout << "  -k dir               take the tiles that did not change since an earlier run" << endl;
+	cout << "                       from dir, filtering and saving there only the others" << endl;
+	cout << "  -L sigma             laplacian-of-gaussian of this sigma (at least 1) instead" << endl;
+	cout << "                       of the 5x5 one, in separable passes or whole with -e clamp" << endl;
+	cout << "  -o path              output image (default: examples/lenaGrayOut.png)" << endl;
+	cout << "                       .pgm and .raw inputs and outputs are memory-mapped, a" << endl;
+	cout << "                       band of rows per process, so -g, -H, -i and -P do not apply" << endl;
+	cout << "  -p levels[:finest]   filter a pyramid of levels halved copies, the coarsest first," << endl;
+	cout << "                       into -o with -level before its extension, down to finest" << endl;
+	cout << "  -P                   send bands in chunks of a tile's height, filtering" << endl;
+	cout << "                       what has arrived while the rest is in flight" << endl;
+	cout << "  -r WxH               size of a headerless .raw input" << endl;
+	cout << "  -R WxH+X+Y           read and filter only the W x H window at (X, Y), into -o" << endl;
+	cout << "  -s                   stream a PNG row by row, in memory bounded by its width, not with -b" << endl;
+	cout << "  -S schedule          static, dynamic or guided tiles on threads (default: static)" << endl;
+	cout << "  -t threads           threads per process (default: one per core)" << endl;
+	cout << "  -T WxH               size of the tiles threads work on (default: " 
+		<< TILE_W << "x" << TILE_H << ")" << endl;
+	cout << "  -V                   check every engine and kernel against plain loops, and" << endl;
+	cout << "                       -L's separable passes against its whole kernel, and exit" << endl;
+	cout << "  -z slope             write a thinned edge map of the zero crossings at least" << endl;
+	cout << "                       this steep instead of the filtered values" << endl;
+}
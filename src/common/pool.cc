@@ -0,0 +1,213 @@
+/*
+ ============================================================================
+ Name        : pool.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Persistent pthreads pool with work stealing between its
+threads.
+ ============================================================================
+*/
+#include <cstdlib>
+#include <pthread.h>
+#include <sys/sysinfo.h>
+#include "pool.h"
+
+/* tasks [next, end) not yet taken from a thread. the owner takes from the
+ * front and thieves from the back */
+typedef struct {
+	pthread_mutex_t lock;
+	int next, end;
+} task_queue;
+
+struct pool {
+	int size;
+	pthread_t *threads; /* size - 1 of them, the caller being thread 0 */
+	task_queue *queues; /* one per thread */
+
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	long job;           /* bumped for every job */
+	int busy;           /* threads still on the current job */
+	bool quit;
+
+	task_fn fn;
+	void *arg;
+};
+
+typedef struct {
+	pool *workers;
+	int idt;
+} worker_arg;
+
+/* takes the first task of queue q, or returns -1 if it is empty */
+static int takeTask(task_queue *q) {
+	int t = -1;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->next < q->end) t = q->next++;
+	pthread_mutex_unlock(&q->lock);
+
+	return t;
+}
+
+/* moves the back half of the tasks of another thread to thread idt.
+ * returns false when every queue is empty */
+static bool stealTasks(pool *workers, int idt) {
+	for (int k = 1; k < workers->size; ++k) {
+		task_queue *victim = &workers->queues[(idt + k) % workers->size];
+		int from = 0, to = 0;
+
+		pthread_mutex_lock(&victim->lock);
+
+		if (victim->next < victim->end) {
+			to = victim->end;
+			from = to - (to - victim->next + 1) / 2;
+			victim->end = from;
+		}
+
+		pthread_mutex_unlock(&victim->lock);
+
+		if (from < to) {
+			task_queue *own = &workers->queues[idt];
+
+			pthread_mutex_lock(&own->lock);
+			own->next = from;
+			own->end = to;
+			pthread_mutex_unlock(&own->lock);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* runs tasks of the current job until there are none left anywhere */
+static void work(pool *workers, int idt) {
+	do {
+		int t;
+
+		while ((t = takeTask(&workers->queues[idt])) >= 0)
+			workers->fn(t, workers->arg);
+	} while (stealTasks(workers, idt));
+}
+
+static void* worker_func(void *arg) {
+	worker_arg *w_arg = (worker_arg*) arg;
+	pool *workers = w_arg->workers;
+	int idt = w_arg->idt;
+	long seen = 0;
+
+	free(w_arg);
+
+	for (;;) {
+		pthread_mutex_lock(&workers->lock);
+
+		while (!workers->quit && workers->job == seen)
+			pthread_cond_wait(&workers->start, &workers->lock);
+
+		if (workers->quit) {
+			pthread_mutex_unlock(&workers->lock);
+			return NULL;
+		}
+
+		seen = workers->job;
+		pthread_mutex_unlock(&workers->lock);
+
+		work(workers, idt);
+
+		pthread_mutex_lock(&workers->lock);
+		if (--workers->busy == 0) pthread_cond_signal(&workers->done);
+		pthread_mutex_unlock(&workers->lock);
+	}
+}
+
+pool* newPool(int size) {
+	pool *workers = (pool*) malloc(sizeof(pool));
+
+	if (size <= 0) size = get_nprocs();
+	if (size <= 0) size = 1;
+
+	workers->size = size;
+	workers->threads = (pthread_t*) malloc(sizeof(pthread_t) * size);
+	workers->queues = (task_queue*) malloc(sizeof(task_queue) * size);
+	workers->job = 0;
+	workers->busy = 0;
+	workers->quit = false;
+	workers->fn = NULL;
+	workers->arg = NULL;
+
+	pthread_mutex_init(&workers->lock, NULL);
+	pthread_cond_init(&workers->start, NULL);
+	pthread_cond_init(&workers->done, NULL);
+
+	for (int i = 0; i < size; ++i) {
+		pthread_mutex_init(&workers->queues[i].lock, NULL);
+		workers->queues[i].next = workers->queues[i].end = 0;
+	}
+
+	for (int i = 1; i < size; ++i) {
+		worker_arg *w_arg = (worker_arg*) malloc(sizeof(worker_arg));
+
+		w_arg->workers = workers;
+		w_arg->idt = i;
+
+		pthread_create(&workers->threads[i], NULL, worker_func, w_arg);
+	}
+
+	return workers;
+}
+
+int poolSize(const pool *workers) {
+	return workers->size;
+}
+
+void runPool(pool *workers, int tasks, task_fn fn, void *arg) {
+	int size = workers->size;
+
+	/* an even share each to start with */
+	for (int i = 0; i < size; ++i) {
+		workers->queues[i].next = (long) tasks * i / size;
+		workers->queues[i].end = (long) tasks * (i + 1) / size;
+	}
+
+	pthread_mutex_lock(&workers->lock);
+	workers->fn = fn;
+	workers->arg = arg;
+	workers->busy = size - 1;
+	workers->job++;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+
+	/* the calling thread is thread 0 */
+	work(workers, 0);
+
+	pthread_mutex_lock(&workers->lock);
+	while (workers->busy > 0)
+		pthread_cond_wait(&workers->done, &workers->lock);
+	pthread_mutex_unlock(&workers->lock);
+}
+
+void deletePool(pool *workers) {
+	if (!workers) return;
+
+	pthread_mutex_lock(&workers->lock);
+	workers->quit = true;
+	pthread_cond_broadcast(&workers->start);
+	pthread_mutex_unlock(&workers->lock);
+
+	for (int i = 1; i < workers->size; ++i)
+		pthread_join(workers->threads[i], NULL);
+
+	for (int i = 0; i < workers->size; ++i)
+		pthread_mutex_destroy(&workers->queues[i].lock);
+
+	pthread_mutex_destroy(&workers->lock);
+	pthread_cond_destroy(&workers->start);
+	pthread_cond_destroy(&workers->done);
+
+	free(workers->threads);
+	free(workers->queues);
+	free(workers);
+}
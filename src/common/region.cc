@@ -0,0 +1,278 @@
+/*
+ ============================================================================
+ Name        : region.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Filtering of a window of an image, or of a pyramid of coarser
+copies of it, instead of the whole image.
+ ============================================================================
+*/
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "region.h"
+#include "convolve.h"
+#include "mapped.h"
+#include "stream.h"
+#include "timing.h"
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+
+void copyWindow(const uByte *src, int w, int x0, int y0, int x1, int y1,
+	uByte *dst) {
+	for (int y = y0; y < y1; ++y) {
+		memcpy(dst + (long) (y - y0) * (x1 - x0), src + (long) y * w + x0,
+			x1 - x0);
+	}
+}
+
+void levelSize(int w, int h, int k, int *lw, int *lh) {
+	*lw = w;
+	*lh = h;
+
+	for (int l = 0; l < k; ++l) {
+		*lw = (*lw + 1) / 2;
+		*lh = (*lh + 1) / 2;
+	}
+}
+
+/* row y / 2 of next, from rows y - 1 and y of img, y being odd or the last
+ * row. odd widths and heights replicate their last column and row */
+static void halveRow(const image *img, int y, image *next) {
+	int w = img->width;
+	const uByte *a = img->data + (long) (y - y % 2) * w;
+	const uByte *b = img->data + (long) y * w;
+	uByte *out = next->data + (long) (y / 2) * next->width;
+
+	for (int x = 0; x < next->width; ++x) {
+		int x0 = 2 * x, x1 = min(2 * x + 1, w - 1);
+
+		out[x] = (a[x0] + a[x1] + b[x0] + b[x1] + 2) / 4;
+	}
+}
+
+/* row y of level k is in: the next level may get a row out of it, and so
+ * on down */
+static void descend(image **level, int levels, int k, int y) {
+	if (k + 1 == levels) return;
+
+	if (y % 2 == 0 && y != level[k]->height - 1) return;
+
+	halveRow(level[k], y, level[k + 1]);
+	descend(level, levels, k + 1, y / 2);
+}
+
+image** buildPyramid(image *img, int levels) {
+	image **level = (image**) malloc(sizeof(image*) * levels);
+
+	level[0] = img;
+
+	for (int k = 1; k < levels; ++k) {
+		int lw, lh;
+
+		levelSize(img->width, img->height, k, &lw, &lh);
+		level[k] = newImage(lw, lh);
+	}
+
+	for (int y = 0; y < img->height; ++y) descend(level, levels, 0, y);
+
+	return level;
+}
+
+/* size of the input, from its header only. the offset of the first pixel
+ * of a PGM or raw image goes to *offset. returns 0, or -1 on error, which
+ * is printed */
+static int openInput(const options *opts, int *w, int *h, long *offset) {
+	format_t format = formatOf(opts->input);
+
+	if (format == FORMAT_PNG) return readPngSize(opts->input, w, h);
+
+	*w = opts->rawWidth;
+	*h = opts->rawHeight;
+	*offset = readHeader(opts->input, format, w, h);
+
+	return *offset < 0? -1 : 0;
+}
+
+/* [x0, x1) x [y0, y1) of a w-wide input opened by openInput, decoding
+ * only rows up to y1 of a PNG and mapping just those rows of a PGM or raw
+ * one. returns NULL on error, which is printed */
+static image* readRegion(const options *opts, long offset, int w,
+	int x0, int y0, int x1, int y1) {
+	image *rows;
+
+	if (formatOf(opts->input) == FORMAT_PNG)
+		rows = readPngRows(opts->input, y0, y1);
+	else
+		rows = mapRows(opts->input, offset, w, y0, y1, false);
+
+	if (!rows) return NULL;
+
+	/* decoded rows that span the whole width are the region already */
+	if (formatOf(opts->input) == FORMAT_PNG && x0 == 0 && x1 == w)
+		return rows;
+
+	image *region = newImage(x1 - x0, y1 - y0);
+
+	copyWindow(rows->data, w, x0, 0, x1, y1 - y0, region->data);
+	deleteImage(rows);
+
+	return region;
+}
+
+/* writes gray values as PNG, PGM or raw depending on the extension */
+static int saveImage(const image *img, const char *path) {
+	format_t format = formatOf(path);
+
+	return format == FORMAT_PNG? writePng(img, path) :
+		saveMapped(img, path, format);
+}
+
+int filterWindow(const options *opts, MPI_Comm comm, whole_fn filter,
+	void *arg) {
+	int x0 = opts->roiX, y0 = opts->roiY;
+	int x1 = x0 + opts->roiWidth, y1 = y0 + opts->roiHeight;
+	int rx0 = 0, ry0 = 0, rx1 = 0, ry1 = 0;
+	int dims[4] = {0, 0, 0, 0}; /* size of the region, 0 on error, and start */
+	int ox, oy; /* tile origin outside the window */
+	int rank, result;
+	image *region = NULL;
+
+	MPI_Comm_rank(comm, &rank);
+
+	if (rank == 0) {
+		int w, h, r = filterRadius();
+		long offset = 0;
+
+		enterPhase(PHASE_DECODE);
+
+		if (openInput(opts, &w, &h, &offset) == 0) {
+			if (x1 > w || y1 > h) {
+				cout << "Error: the window " << x1 - x0 << "x" << y1 - y0 << "+"
+					<< x0 << "+" << y0 << " lies outside the " << w << "x" << h
+					<< " image." << endl;
+			} else {
+				/* the window and the pixels the filter reads around it */
+				rx0 = max(x0 - r, 0);
+				ry0 = max(y0 - r, 0);
+				rx1 = min(x1 + r, w);
+				ry1 = min(y1 + r, h);
+
+				region = readRegion(opts, offset, w, rx0, ry0, rx1, ry1);
+			}
+		}
+
+		if (region) {
+			dims[0] = rx1 - rx0;
+			dims[1] = ry1 - ry0;
+			dims[2] = rx0;
+			dims[3] = ry0;
+		}
+	}
+
+	/* every process works out the split from the size of the region, and
+	 * lines its tiles up with those of the image from where it starts */
+	MPI_Bcast(dims, 4, MPI_INT, 0, comm);
+
+	if (dims[0] == 0) return -1;
+
+	tileOriginOf(&ox, &oy);
+	tileOrigin(ox + dims[2], oy + dims[3]);
+	result = filter(region, dims[0], dims[1], opts, comm, arg);
+	tileOrigin(ox, oy);
+
+	if (rank == 0 && result == 0) {
+		image *window = newImage(x1 - x0, y1 - y0);
+
+		enterPhase(PHASE_ENCODE);
+		copyWindow(region->data, dims[0], x0 - rx0, y0 - ry0, x1 - rx0,
+			y1 - ry0, window->data);
+		result = saveImage(window, opts->output);
+		deleteImage(window);
+	}
+
+	deleteImage(region);
+
+	return result;
+}
+
+/* path with the level k before its extension, as in out-2.png */
+static void levelPath(const char *path, int k, char *out, int size) {
+	const char *dot = strrchr(path, '.'), *slash = strrchr(path, '/');
+
+	if (!dot || (slash && dot < slash)) dot = path + strlen(path);
+
+	snprintf(out, size, "%.*s-%d%s", (int) (dot - path), path, k, dot);
+}
+
+int filterPyramid(const options *opts, MPI_Comm comm, whole_fn filter,
+	void *arg) {
+	int dims[2] = {0, 0}; /* size of the input, 0 on error */
+	int rank, result = 0;
+	image *base = NULL, **levels = NULL;
+
+	MPI_Comm_rank(comm, &rank);
+
+	if (rank == 0) {
+		int w, h;
+		long offset = 0;
+
+		enterPhase(PHASE_DECODE);
+
+		if (openInput(opts, &w, &h, &offset) == 0) {
+			base = readRegion(opts, offset, w, 0, 0, w, h);
+
+			if (base) {
+				enterPhase(PHASE_INGEST);
+				levels = buildPyramid(base, opts->levels);
+				dims[0] = w;
+				dims[1] = h;
+			}
+		}
+	}
+
+	MPI_Bcast(dims, 2, MPI_INT, 0, comm);
+
+	if (dims[0] == 0) return -1;
+
+	/* coarsest first, so that previews come out before the finer levels */
+	for (int k = opts->levels - 1; k >= opts->finest; --k) {
+		int lw, lh;
+
+		levelSize(dims[0], dims[1], k, &lw, &lh);
+
+		if (filter(rank == 0? levels[k] : NULL, lw, lh, opts, comm, arg) != 0) {
+			result = -1;
+			break;
+		}
+
+		if (rank == 0) {
+			char path[4096];
+
+			enterPhase(PHASE_ENCODE);
+			levelPath(opts->output, k, path, sizeof(path));
+
+			if (saveImage(levels[k], path) != 0) {
+				result = -1;
+			} else {
+				cout << "Level " << k << ": " << lw << "x" << lh << " in " << path
+					<< endl;
+			}
+		}
+	}
+
+	if (rank == 0) {
+		for (int k = 1; k < opts->levels; ++k) deleteImage(levels[k]);
+
+		free(levels);
+		deleteImage(base);
+	}
+
+	return result;
+}
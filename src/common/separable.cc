@@ -0,0 +1,217 @@
+/*
+ ============================================================================
+ Name        : separable.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Laplacian-of-gaussian of any sigma, in separable passes of
+one dimension each.
+ ============================================================================
+*/
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include "separable.h"
+#include "buffers.h"
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+using std::vector;
+
+/* kernels of the selected sigma, taps [0, 2 * radius] */
+static double selected = 0;
+static int radius = 2;
+static float *gauss = NULL;  /* the gaussian */
+static float *second = NULL; /* its second derivative, negated and scaled */
+static double *whole = NULL; /* the 2D kernel, [i][j] row-major by j */
+
+void sigmaSelect(double sigma) {
+	free(gauss);
+	free(second);
+	free(whole);
+
+	gauss = second = NULL;
+	whole = NULL;
+	selected = sigma;
+	radius = 2;
+
+	if (sigma <= 0) return;
+
+	radius = (int) ceil(SIGMA_REACH * sigma);
+
+	int n = 2 * radius + 1;
+	vector<double> g(n), d(n);
+	double mean = 0, dMean = 0, absSum = 0;
+
+	gauss = (float*) malloc(sizeof(float) * n);
+	second = (float*) malloc(sizeof(float) * n);
+	whole = (double*) malloc(sizeof(double) * n * n);
+
+	for (int k = 0; k < n; ++k) {
+		double t = k - radius;
+
+		g[k] = exp(-t * t / (2 * sigma * sigma));
+		d[k] = (t * t / (sigma * sigma) - 1) / (sigma * sigma) * g[k];
+		dMean += d[k] / n;
+	}
+
+	/* the negated laplacian, shifted to sum to 0 */
+	for (int k = 0; k < n * n; ++k) {
+		int i = k % n, j = k / n;
+
+		whole[k] = -(d[i] * g[j] + g[i] * d[j]);
+		mean += whole[k] / (n * n);
+	}
+
+	for (int k = 0; k < n * n; ++k) {
+		whole[k] -= mean;
+		absSum += fabs(whole[k]);
+	}
+
+	/* weighing as much in total as lapOfGau */
+	double gain = 32 / absSum;
+
+	for (int k = 0; k < n * n; ++k) whole[k] *= gain;
+
+	/* a shifted derivative sums to 0 too, so both answer 0 to flat areas */
+	for (int k = 0; k < n; ++k) {
+		gauss[k] = g[k];
+		second[k] = -gain * (d[k] - dMean);
+	}
+}
+
+double sigmaSelected() {
+	return selected;
+}
+
+int sigmaRadius() {
+	return radius;
+}
+
+static inline uByte toGray(double v) {
+	return v < 0? 0 : v > 255? 255 : (uByte) floor(v + 0.5);
+}
+
+/* unclamped values of the whole kernel at row y, columns [x0, x1) */
+static void wholeSums(const uByte *src, int w, int h, int y, int x0, int x1,
+	float *sums) {
+	int n = 2 * radius + 1;
+
+	for (int x = x0; x < x1; ++x) {
+		double sum = 0;
+
+		for (int j = 0; j < n; ++j) {
+			const uByte *row = src + (long) min(max(y + j - radius, 0), h - 1) * w;
+
+			for (int i = 0; i < n; ++i)
+				sum += whole[i + j * n] * row[min(max(x + i - radius, 0), w - 1)];
+		}
+
+		sums[x - x0] = sum;
+	}
+}
+
+/* same with the separable passes, vg and vd holding room for the columns
+ * [x0 - radius, x1 + radius) */
+static void separableSums(const uByte *src, int w, int h, int y,
+	int x0, int x1, float *vg, float *vd, float *sums) {
+	int n = 2 * radius + 1;
+
+	/* columns the horizontal passes read */
+	int cx0 = max(x0 - radius, 0), cx1 = min(x1 + radius, w);
+
+	/* vertical passes, down the rows around y */
+	for (int c = 0; c < cx1 - cx0; ++c) vg[c] = vd[c] = 0;
+
+	for (int k = 0; k < n; ++k) {
+		const uByte *row = src + (long) min(max(y + k - radius, 0), h - 1) * w + cx0;
+		float gk = gauss[k], dk = second[k];
+
+		for (int c = 0; c < cx1 - cx0; ++c) {
+			vg[c] += gk * row[c];
+			vd[c] += dk * row[c];
+		}
+	}
+
+	/* horizontal ones, the derivative over the gaussian's columns and the
+	 * other way around, clamping the columns only near the edges */
+	for (int x = x0; x < x1; ++x) {
+		float sum = 0;
+
+		if (x - radius >= 0 && x + radius < w) {
+			const float *g = vg + x - radius - cx0, *d = vd + x - radius - cx0;
+
+			for (int k = 0; k < n; ++k)
+				sum += second[k] * g[k] + gauss[k] * d[k];
+		} else {
+			for (int k = 0; k < n; ++k) {
+				int c = min(max(x + k - radius, 0), w - 1) - cx0;
+
+				sum += second[k] * vg[c] + gauss[k] * vd[c];
+			}
+		}
+
+		sums[x - x0] = sum;
+	}
+}
+
+void sigmaSpan(const uByte *src, uByte *out, int w, int h,
+	int x0, int y0, int x1, int y1, engine_t engine) {
+	int span = x1 - x0 + 2 * radius;
+	float *vg = (float*) scratchBuffer(SCRATCH_SIGMA,
+		sizeof(float) * (2 * span + x1 - x0));
+	float *vd = vg + span, *sums = vd + span;
+
+	for (int y = y0; y < y1; ++y) {
+		if (engine == ENGINE_CLAMP)
+			wholeSums(src, w, h, y, x0, x1, sums);
+		else
+			separableSums(src, w, h, y, x0, x1, vg, vd, sums);
+
+		for (int x = x0; x < x1; ++x)
+			out[x + (long) (y - y0) * w] = toGray(sums[x - x0]);
+	}
+}
+
+void sigmaSigned(const uByte *src, int w, int h, int y, int x0, int x1,
+	engine_t engine, int *out) {
+	int span = x1 - x0 + 2 * radius;
+	float *vg = (float*) scratchBuffer(SCRATCH_SIGMA,
+		sizeof(float) * (2 * span + x1 - x0));
+	float *vd = vg + span, *sums = vd + span;
+
+	if (engine == ENGINE_CLAMP)
+		wholeSums(src, w, h, y, x0, x1, sums);
+	else
+		separableSums(src, w, h, y, x0, x1, vg, vd, sums);
+
+	for (int x = x0; x < x1; ++x)
+		out[x - x0] = (int) floor(sums[x - x0] + 0.5);
+}
+
+int verifySigma(const uByte *img, int w, int h) {
+	uByte *expected = (uByte*) malloc(sizeof(uByte) * w * h);
+	uByte *actual = (uByte*) malloc(sizeof(uByte) * w * h);
+	int worst = 0;
+
+	sigmaSpan(img, expected, w, h, 0, 0, w, h, ENGINE_CLAMP);
+	sigmaSpan(img, actual, w, h, 0, 0, w, h, ENGINE_SPLIT);
+
+	for (long k = 0; k < (long) w * h; ++k)
+		worst = max(worst, abs(expected[k] - actual[k]));
+
+	free(expected);
+	free(actual);
+
+	if (worst > SIGMA_BOUND) {
+		cout << "Mismatch: sigma " << selected << " on " << w << "x" << h
+			<< ", off by " << worst << " > " << SIGMA_BOUND << endl;
+		return 1;
+	}
+
+	return 0;
+}
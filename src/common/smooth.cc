@@ -0,0 +1,56 @@
+/*
+ ============================================================================
+ Name        : smooth.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Smoothing run ahead of the filter, tile by tile.
+ ============================================================================
+*/
+#include "smooth.h"
+#include "kernel.h"
+
+static blur_t selected = BLUR_NONE;
+
+void blurSelect(blur_t blur) {
+	selected = blur;
+}
+
+blur_t blurSelected() {
+	return selected;
+}
+
+template <const Filter5 &F>
+static void smoothWith(const uByte *src, int w, int h, int x0, int y0,
+	int x1, int y1, uByte *out) {
+	constexpr int divisor = F.divisor();
+	const uByte *rows[5];
+
+	/* interior columns of this span */
+	int ix0 = std::min(std::max(x0, 2), x1);
+	int ix1 = std::max(std::min(x1, w - 2), ix0);
+
+	for (int y = y0; y < y1; ++y) {
+		uByte *row = out + (long) (y - y0) * (x1 - x0);
+
+		kernelRows<5>(src, w, h, y, rows);
+
+		/* column x goes to row[x - x0], the span starting at out */
+		for (int x = x0; x < ix0; ++x)
+			row[x - x0] = normalize(taps<5, char, F>::clamped(rows, w, x), divisor);
+
+		for (int x = ix0; x < ix1; ++x)
+			row[x - x0] = normalize(taps<5, char, F>::interior(rows, x), divisor);
+
+		for (int x = ix1; x < x1; ++x)
+			row[x - x0] = normalize(taps<5, char, F>::clamped(rows, w, x), divisor);
+	}
+}
+
+void smoothRegion(const uByte *src, int w, int h, int x0, int y0, int x1,
+	int y1, uByte *out) {
+	if (selected == BLUR_AVERAGE)
+		smoothWith<average>(src, w, h, x0, y0, x1, y1, out);
+	else
+		smoothWith<gaussian>(src, w, h, x0, y0, x1, y1, out);
+}
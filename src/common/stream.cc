@@ -0,0 +1,334 @@
+/*
+ ============================================================================
+ Name        : stream.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : PNG decoding and encoding through libpng, of whole images
+or row by row, filtering in memory bounded by the image width.
+ ============================================================================
+*/
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <png.h>
+#include "stream.h"
+#include "image.h"
+
+using std::cout;
+using std::endl;
+using std::min;
+using std::max;
+
+int filterStream(const char *inPath, const char *outPath, engine_t engine) {
+	png_structp rd = NULL, wr = NULL;
+	png_infop rdInfo = NULL, wrInfo = NULL;
+	/* volatile: set after setjmp, or kept in registers across it, and read
+	 * back after a longjmp */
+	FILE *volatile in = NULL;
+	FILE *volatile out = NULL;
+	uByte *volatile decoded = NULL; /* one decoded row, gray or RGB */
+	uByte *volatile ring = NULL;    /* gray rows y - 2 to y + 2, row r in r % 5 */
+	uByte *volatile line = NULL;    /* one filtered row */
+	volatile int result = -1;
+	volatile int w = 0, h = 0;
+
+	if (!(in = fopen(inPath, "rb"))) {
+		cout << "Error: image '" << inPath << "' not found." << endl;
+		goto done;
+	}
+
+	if (!(out = fopen(outPath, "wb"))) {
+		cout << "Error: cannot write '" << outPath << "'." << endl;
+		goto done;
+	}
+
+	rd = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	wr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+
+	if (rd) rdInfo = png_create_info_struct(rd);
+	if (wr) wrInfo = png_create_info_struct(wr);
+
+	if (!rdInfo || !wrInfo) {
+		cout << "Error: cannot set up libpng." << endl;
+		goto done;
+	}
+
+	/* libpng jumps here on any decode or encode error */
+	if (setjmp(png_jmpbuf(rd))) {
+		cout << "Error: '" << inPath << "' could not be decoded." << endl;
+		goto done;
+	}
+
+	if (setjmp(png_jmpbuf(wr))) {
+		cout << "Error: '" << outPath << "' could not be encoded." << endl;
+		goto done;
+	}
+
+	png_init_io(rd, in);
+	png_read_info(rd, rdInfo);
+
+	if (png_get_interlace_type(rd, rdInfo) != PNG_INTERLACE_NONE) {
+		cout << "Error: interlaced PNGs cannot be streamed." << endl;
+		goto done;
+	}
+
+	/* down to 8-bit gray or RGB */
+	png_set_expand(rd);
+	png_set_strip_16(rd);
+	png_set_strip_alpha(rd);
+	png_read_update_info(rd, rdInfo);
+
+	w = png_get_image_width(rd, rdInfo);
+	h = png_get_image_height(rd, rdInfo);
+
+	png_init_io(wr, out);
+	png_set_IHDR(wr, wrInfo, w, h, 8, PNG_COLOR_TYPE_GRAY,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+		PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(wr, wrInfo);
+
+	{
+		int channels = png_get_channels(rd, rdInfo);
+		int read = 0; /* rows decoded so far */
+
+		decoded = (uByte*) malloc(sizeof(uByte) * w * channels);
+		ring = (uByte*) malloc(sizeof(uByte) * w * 5);
+		line = (uByte*) malloc(sizeof(uByte) * w);
+
+		for (int y = 0; y < h; ++y) {
+			const uByte *rows[5];
+
+			/* decode up to row y + 2, replicating the bottom edge */
+			for (; read <= min(y + 2, h - 1); ++read) {
+				uByte *gray = ring + (read % 5) * w;
+
+				png_read_row(rd, channels == 1? gray : (uByte*) decoded, NULL);
+
+				if (channels == 3) rgbToGray(decoded, gray, w);
+			}
+
+			for (int j = 0; j < 5; ++j)
+				rows[j] = ring + (min(max(y + j - 2, 0), h - 1) % 5) * w;
+
+			filterRow(rows, line, w, 0, w, engine);
+			png_write_row(wr, line);
+		}
+	}
+
+	png_read_end(rd, NULL);
+	png_write_end(wr, wrInfo);
+
+	result = 0;
+
+done:
+	if (rd) png_destroy_read_struct(&rd, rdInfo? &rdInfo : NULL, NULL);
+	if (wr) png_destroy_write_struct(&wr, wrInfo? &wrInfo : NULL);
+
+	if (in) fclose(in);
+	if (out) fclose(out);
+
+	free(decoded);
+	free(ring);
+	free(line);
+
+	return result;
+}
+
+int readPngSize(const char *path, int *w, int *h) {
+	FILE *in;
+	png_structp rd = NULL;
+	png_infop info = NULL;
+	volatile int result = -1;
+
+	if (!(in = fopen(path, "rb"))) {
+		cout << "Error: image '" << path << "' not found." << endl;
+		return -1;
+	}
+
+	rd = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+
+	if (rd) info = png_create_info_struct(rd);
+
+	if (!info) {
+		cout << "Error: cannot set up libpng." << endl;
+		goto done;
+	}
+
+	if (setjmp(png_jmpbuf(rd))) {
+		cout << "Error: '" << path << "' could not be decoded." << endl;
+		goto done;
+	}
+
+	png_init_io(rd, in);
+	png_read_info(rd, info);
+
+	*w = png_get_image_width(rd, info);
+	*h = png_get_image_height(rd, info);
+	result = 0;
+
+done:
+	if (rd) png_destroy_read_struct(&rd, info? &info : NULL, NULL);
+
+	fclose(in);
+
+	return result;
+}
+
+/* rows [y0, y1) of a PNG, or down to its last row when y1 is -1 */
+static image* decodeRows(const char *path, int y0, int y1) {
+	FILE *in;
+	png_structp rd = NULL;
+	png_infop info = NULL;
+	/* volatile: set after setjmp and read back after a longjmp */
+	image *volatile img = NULL;
+	uByte *volatile decoded = NULL; /* decoded RGB rows, and a spare row */
+	volatile bool ok = false;
+	int passes;
+
+	if (!(in = fopen(path, "rb"))) {
+		cout << "Error: image '" << path << "' not found." << endl;
+		return NULL;
+	}
+
+	rd = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+
+	if (rd) info = png_create_info_struct(rd);
+
+	if (!info) {
+		cout << "Error: cannot set up libpng." << endl;
+		goto done;
+	}
+
+	if (setjmp(png_jmpbuf(rd))) {
+		cout << "Error: '" << path << "' could not be decoded." << endl;
+		goto done;
+	}
+
+	png_init_io(rd, in);
+	png_read_info(rd, info);
+
+	/* down to 8-bit gray or RGB, deinterlaced */
+	png_set_expand(rd);
+	png_set_strip_16(rd);
+	png_set_strip_alpha(rd);
+	passes = png_set_interlace_handling(rd);
+	png_read_update_info(rd, info);
+
+	{
+		int w = png_get_image_width(rd, info);
+		int h = png_get_image_height(rd, info);
+		int channels = png_get_channels(rd, info);
+		int end = y1 < 0? h : y1;
+
+		if (y0 < 0 || y0 > end || end > h) {
+			cout << "Error: rows " << y0 << " to " << end << " lie outside the "
+				<< w << "x" << h << " image '" << path << "'." << endl;
+			goto done;
+		}
+
+		/* interlaced images come in passes over every row, each adding
+		 * pixels to the rows before, so interlaced RGB rows of the region
+		 * are kept until the last pass. rows outside the region go to the
+		 * spare row after them */
+		int kept = channels == 3 && passes > 1? end - y0 : 0;
+		uByte *spare;
+
+		img = newImage(w, end - y0);
+		decoded = (uByte*) malloc(sizeof(uByte) * w * channels * (kept + 1));
+		spare = decoded + (long) kept * w * channels;
+
+		/* past the region only for the passes after the first */
+		int last = passes > 1? h : end;
+
+		for (int pass = 0; pass < passes; ++pass) {
+			for (int y = 0; y < last; ++y) {
+				if (y < y0 || y >= end) {
+					png_read_row(rd, spare, NULL);
+				} else if (channels == 1) {
+					png_read_row(rd, img->data + (long) (y - y0) * w, NULL);
+				} else if (passes > 1) {
+					png_read_row(rd, decoded + (long) (y - y0) * w * 3, NULL);
+				} else {
+					png_read_row(rd, spare, NULL);
+					rgbToGray(spare, img->data + (long) (y - y0) * w, w);
+				}
+			}
+		}
+
+		if (kept > 0) rgbToGray(decoded, img->data, (long) w * kept);
+
+		/* the rows after the region are never decoded */
+		if (last == h) png_read_end(rd, NULL);
+	}
+
+	ok = true;
+
+done:
+	if (rd) png_destroy_read_struct(&rd, info? &info : NULL, NULL);
+
+	fclose(in);
+	free(decoded);
+
+	if (!ok) {
+		deleteImage(img);
+		return NULL;
+	}
+
+	return img;
+}
+
+image* readPng(const char *path) {
+	return decodeRows(path, 0, -1);
+}
+
+image* readPngRows(const char *path, int y0, int y1) {
+	return decodeRows(path, y0, y1);
+}
+
+int writePng(const image *img, const char *path) {
+	FILE *out;
+	png_structp wr = NULL;
+	png_infop info = NULL;
+	volatile int result = -1;
+
+	if (!(out = fopen(path, "wb"))) {
+		cout << "Error: cannot write '" << path << "'." << endl;
+		return -1;
+	}
+
+	wr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+
+	if (wr) info = png_create_info_struct(wr);
+
+	if (!info) {
+		cout << "Error: cannot set up libpng." << endl;
+		goto done;
+	}
+
+	if (setjmp(png_jmpbuf(wr))) {
+		cout << "Error: '" << path << "' could not be encoded." << endl;
+		goto done;
+	}
+
+	png_init_io(wr, out);
+	png_set_IHDR(wr, info, img->width, img->height, 8, PNG_COLOR_TYPE_GRAY,
+		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+		PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(wr, info);
+
+	for (int y = 0; y < img->height; ++y)
+		png_write_row(wr, img->data + (long) y * img->width);
+
+	png_write_end(wr, info);
+
+	result = 0;
+
+done:
+	if (wr) png_destroy_write_struct(&wr, info? &info : NULL);
+
+	fclose(out);
+
+	return result;
+}
@@ -0,0 +1,390 @@
+/*
+ ============================================================================
+ Name        : timing.cc
+ Author      : Ronaldo Vieira
+ Version     : 0.0.1
+ Copyright   : MIT License
+ Description : Time spent in each phase of a run, printed as CSV for the
+benchmarks, and traces of the phases and tiles of every process and thread.
+ ============================================================================
+*/
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <cerrno>
+#include <ctime>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "timing.h"
+
+using std::cout;
+using std::endl;
+
+static double spent[PHASES];
+static phase_t current = PHASE_NONE;
+static double since = 0;
+
+/* one recorded span of a thread */
+typedef struct {
+	const char *name;
+	double begin, end;
+	int thread, x, y;
+	long long counts[TRACE_COUNTERS];
+} event;
+
+/* events are kept in chunks of this many, allocated as they fill */
+#define TRACE_CHUNK (1 << 12)
+#define TRACE_CHUNKS (TRACE_EVENTS / TRACE_CHUNK)
+
+static bool on = false;
+static bool counting = false;
+static double epoch;       /* start of the trace, the same on every process */
+static event *chunks[TRACE_CHUNKS];
+static long recorded = 0;  /* events recorded or dropped, taken atomically */
+static int threads = 0;    /* threads seen, taken atomically */
+static int generation = 0; /* traces started, so threads rejoin each one */
+static mark phaseBegin;    /* where the current phase started */
+
+/* counters opened by every thread, closed when the trace is written */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int *opened = NULL;
+static int openCount = 0;
+
+static const char *counterNames[TRACE_COUNTERS] = {"cycles", "llc_misses"};
+
+/* index of the calling thread in the trace, and its counters, as of the
+ * trace it last joined */
+static __thread int self = -1;
+static __thread int fds[TRACE_COUNTERS] = {-1, -1};
+static __thread int joined = -1;
+
+static double now() {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* a counter of the calling thread, in user space, added to the ones
+ * traceWrite closes. -1 on error */
+static int openCounter(unsigned type, unsigned long long config) {
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	int fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+
+	if (fd < 0) return -1;
+
+	pthread_mutex_lock(&lock);
+	opened = (int*) realloc(opened, sizeof(int) * (openCount + 1));
+	opened[openCount++] = fd;
+	pthread_mutex_unlock(&lock);
+
+	return fd;
+}
+
+/* the first time a thread marks in a trace, it gets its index and
+ * counters */
+static void joinTrace() {
+	self = __sync_fetch_and_add(&threads, 1);
+	joined = generation;
+	fds[0] = fds[1] = -1;
+
+	if (!counting) return;
+
+	fds[0] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	fds[1] = openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+		PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+void enterPhase(phase_t phase) {
+	double at = now();
+
+	if (current != PHASE_NONE) spent[current] += at - since;
+
+	if (on) {
+		if (current != PHASE_NONE)
+			traceSpan(phaseName(current), &phaseBegin, -1, -1);
+
+		traceMark(&phaseBegin);
+	}
+
+	current = phase;
+	since = at;
+}
+
+double phaseTime(phase_t phase) {
+	return phase == PHASE_NONE? 0 : spent[phase];
+}
+
+const char* phaseName(phase_t phase) {
+	static const char *names[PHASES] = {"decode", "ingest", "scatter",
+		"filter", "gather", "encode"};
+
+	return phase == PHASE_NONE? "none" : names[phase];
+}
+
+void resetPhases() {
+	for (int k = 0; k < PHASES; ++k) spent[k] = 0;
+
+	current = PHASE_NONE;
+}
+
+void printPhases(MPI_Comm comm, int threads, int w, int h) {
+	double local[PHASES + 1], worst[PHASES + 1];
+	int rank, p;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+
+	/* the time waiting here is not part of any phase */
+	enterPhase(PHASE_NONE);
+
+	local[PHASES] = 0;
+
+	for (int k = 0; k < PHASES; ++k) {
+		local[k] = spent[k];
+		local[PHASES] += spent[k];
+	}
+
+	MPI_Reduce(local, worst, PHASES + 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+	if (rank != 0) return;
+
+	double pixels = (double) w * h, total = worst[PHASES];
+	double filter = worst[PHASE_FILTER];
+
+	printf("%d,%d,%d,%d", p, threads, w, h);
+
+	for (int k = 0; k <= PHASES; ++k) printf(",%.6f", worst[k]);
+
+	printf(",%.2f,%.3f\n", total > 0? pixels / total / 1e6 : 0,
+		filter > 0? 2 * pixels / filter / 1e9 : 0);
+	fflush(stdout);
+}
+
+void traceStart(MPI_Comm comm, bool counters) {
+	recorded = 0;
+	threads = 0;
+	counting = counters;
+	++generation;
+
+	/* the main thread is thread 0 */
+	joinTrace();
+
+	if (counting && (fds[0] < 0 || fds[1] < 0)) {
+		int rank;
+
+		MPI_Comm_rank(comm, &rank);
+
+		if (rank == 0)
+			cout << "Error: no hardware counters, perf_event_open failed: "
+				<< strerror(errno) << "." << endl;
+	}
+
+	MPI_Barrier(comm);
+
+	epoch = now();
+	on = true;
+}
+
+bool tracing() {
+	return on;
+}
+
+void traceMark(mark *m) {
+	if (joined != generation) joinTrace();
+
+	m->at = now();
+
+	for (int k = 0; k < TRACE_COUNTERS; ++k) {
+		if (fds[k] < 0 || read(fds[k], &m->counts[k], sizeof(long long)) !=
+			sizeof(long long))
+			m->counts[k] = -1;
+	}
+}
+
+void traceSpan(const char *name, const mark *begin, int x, int y) {
+	mark end;
+
+	traceMark(&end);
+
+	long n = __sync_fetch_and_add(&recorded, 1);
+
+	if (n >= TRACE_EVENTS) return;
+
+	event **chunk = chunks + n / TRACE_CHUNK;
+
+	/* the first event of a chunk allocates it, unless another thread
+	 * got there first */
+	if (!*chunk) {
+		event *fresh = (event*) malloc(sizeof(event) * TRACE_CHUNK);
+
+		if (__sync_val_compare_and_swap(chunk, (event*) NULL, fresh))
+			free(fresh);
+	}
+
+	event *e = *chunk + n % TRACE_CHUNK;
+
+	e->name = name;
+	e->begin = begin->at - epoch;
+	e->end = end.at - epoch;
+	e->thread = self;
+	e->x = x;
+	e->y = y;
+
+	for (int k = 0; k < TRACE_COUNTERS; ++k) {
+		e->counts[k] = begin->counts[k] < 0 || end.counts[k] < 0? -1 :
+			end.counts[k] - begin->counts[k];
+	}
+}
+
+/* appends to a growing string of *size bytes, of which *used are taken */
+static void append(char **text, long *used, long *size, const char *format,
+	...) {
+	va_list args;
+
+	if (*size - *used < 512) {
+		*size = *size * 2 + 512;
+		*text = (char*) realloc(*text, *size);
+	}
+
+	va_start(args, format);
+	*used += vsnprintf(*text + *used, *size - *used, format, args);
+	va_end(args);
+}
+
+/* the events of this process as JSON objects, each followed by a comma */
+static char* traceEvents(int rank, long *used) {
+	long size = 0, n = recorded < TRACE_EVENTS? recorded : TRACE_EVENTS;
+	char *text = NULL;
+
+	*used = 0;
+
+	append(&text, used, &size, "{\"name\":\"process_name\",\"ph\":\"M\","
+		"\"pid\":%d,\"args\":{\"name\":\"rank %d\"}},\n", rank, rank);
+
+	for (int t = 0; t < threads; ++t) {
+		append(&text, used, &size, "{\"name\":\"thread_name\",\"ph\":\"M\","
+			"\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"", rank, t);
+
+		if (t == 0)
+			append(&text, used, &size, "main\"}},\n");
+		else
+			append(&text, used, &size, "thread %d\"}},\n", t);
+	}
+
+	for (long k = 0; k < n; ++k) {
+		const event *e = chunks[k / TRACE_CHUNK] + k % TRACE_CHUNK;
+
+		append(&text, used, &size, "{\"name\":\"%s\",\"cat\":\"%s\","
+			"\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+			"\"args\":{", e->name, e->x < 0? "phase" : "tile", rank, e->thread,
+			e->begin * 1e6, (e->end - e->begin) * 1e6);
+
+		const char *sep = "";
+
+		if (e->x >= 0) {
+			append(&text, used, &size, "\"x\":%d,\"y\":%d", e->x, e->y);
+			sep = ",";
+		}
+
+		for (int c = 0; c < TRACE_COUNTERS; ++c) {
+			if (e->counts[c] < 0) continue;
+
+			append(&text, used, &size, "%s\"%s\":%lld", sep, counterNames[c],
+				e->counts[c]);
+			sep = ",";
+		}
+
+		append(&text, used, &size, "}},\n");
+	}
+
+	return text;
+}
+
+int traceWrite(MPI_Comm comm, const char *path) {
+	int rank, p, result = 0;
+	long used;
+
+	/* the phase going on ends here */
+	enterPhase(PHASE_NONE);
+	on = false;
+
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &p);
+
+	if (recorded > TRACE_EVENTS) {
+		cout << "Rank " << rank << " dropped " << recorded - TRACE_EVENTS
+			<< " events past the first " << TRACE_EVENTS << "." << endl;
+	}
+
+	char *text = traceEvents(rank, &used);
+	int length = used, lengths[p], displs[p];
+	char *all = NULL;
+
+	MPI_Gather(&length, 1, MPI_INT, lengths, 1, MPI_INT, 0, comm);
+
+	if (rank == 0) {
+		long total = 0;
+
+		for (int r = 0; r < p; ++r) {
+			displs[r] = total;
+			total += lengths[r];
+		}
+
+		all = (char*) malloc(total);
+	}
+
+	MPI_Gatherv(text, length, MPI_CHAR, all, lengths, displs, MPI_CHAR, 0,
+		comm);
+
+	if (rank == 0) {
+		FILE *fp = fopen(path, "w");
+		long total = displs[p - 1] + lengths[p - 1];
+
+		if (!fp) {
+			cout << "Error: trace '" << path << "' cannot be written." << endl;
+			result = -1;
+		} else {
+			/* all but the last comma */
+			fputs("{\"traceEvents\":[\n", fp);
+			fwrite(all, 1, total - 2, fp);
+			fputs("\n]}\n", fp);
+			fclose(fp);
+		}
+
+		free(all);
+	}
+
+	free(text);
+
+	for (int c = 0; c < TRACE_CHUNKS; ++c) {
+		free(chunks[c]);
+		chunks[c] = NULL;
+	}
+
+	/* the counters of every thread that joined, which rejoin the next
+	 * trace with new ones */
+	pthread_mutex_lock(&lock);
+
+	for (int k = 0; k < openCount; ++k) close(opened[k]);
+
+	free(opened);
+	opened = NULL;
+	openCount = 0;
+	pthread_mutex_unlock(&lock);
+
+	return result;
+}
@@ -12,15 +12,25 @@ laplacian-of-gaussian filter.
 #include <string>
 #include <cstring>
 #include <cstdio>
-#include <ctime>
 #include <cmath>
 #include <omp.h>
 #include "mpi.h"
 #include "pixelLab.h"
 #include "logcm.h"
-
-#define DEBUG 1
-#define printflush(s, ...) do {if (DEBUG) {printf(s, ##__VA_ARGS__); fflush(stdout);}} while (0)
+#include "convolve.h"
+#include "separable.h"
+#include "edges.h"
+#include "image.h"
+#include "options.h"
+#include "stream.h"
+#include "mapped.h"
+#include "distribute.h"
+#include "batch.h"
+#include "farm.h"
+#include "timing.h"
+#include "buffers.h"
+#include "cache.h"
+#include "region.h"
 
 using std::cout;
 using std::endl;
@@ -29,213 +39,344 @@ using std::max;
 using std::string;
 using std::memcpy;
 
-static long get_nanos(void) {
-    struct timespec ts;
-    timespec_get(&ts, TIME_UTC);
-    return (long) ts.tv_sec * 1000000000L + ts.tv_nsec;
+/* sets the thread count and the schedule every schedule(runtime) loop 
+ * below runs with */
+void setupThreads(const options *opts) {
+	if (opts->threads > 0)
+		omp_set_num_threads(opts->threads);
+	
+	if (opts->schedule == SCHEDULE_DYNAMIC)
+		omp_set_schedule(omp_sched_dynamic, 0);
+	else if (opts->schedule == SCHEDULE_GUIDED)
+		omp_set_schedule(omp_sched_guided, 0);
+	else
+		omp_set_schedule(omp_sched_static, 0);
+}
+
+/* copies src into dst, or zeroes dst when src is NULL, over the same tiles
+ * and schedule as the filter. the first write to a page places it on the 
+ * NUMA node of the writing thread, which under a static schedule is the 
+ * thread that will later convolve that tile */
+void firstTouch(uByte *dst, const uByte *src, int w, int h, 
+	const options *opts) {
+	int tw = opts->tileWidth, th = opts->tileHeight;
+	int tiles = tileCount(w, h, tw, th);
+	
+	#pragma omp parallel for schedule(runtime)
+	for (int t = 0; t < tiles; ++t) {
+		int x0, y0, x1, y1;
+		
+		tileBounds(t, w, h, &x0, &y0, &x1, &y1, tw, th);
+		
+		for (int y = y0; y < y1; ++y) {
+			if (src)
+				memcpy(dst + (long) y * w + x0, src + (long) y * w + x0, 
+					x1 - x0);
+			else
+				memset(dst + (long) y * w + x0, 0, x1 - x0);
+		}
+	}
+}
+
+/* zeroes a band before it is received, see firstTouch */
+void touchBand(uByte *mat, int w, int h, const options *opts) {
+	firstTouch(mat, NULL, w, h, opts);
 }
 
-int* applyFilter(int *mat, int w, int h) {
-	int *orig = (int*) malloc(sizeof(int) * w * h);
-	memcpy(orig, mat, sizeof(int) * w * h);
-	
-	/* for each pixel in the image */
-	#pragma omp parallel for num_threads(4)
-    for (int x = 0; x < w; ++x) {
-        for (int y = 0; y < h; ++y) {
-            int sum = 0;
-            int amount = 0;
-            
-            /* apply the kernel matrix */
-            for (int j = 0; j < 5; ++j) {
-                for (int i = 0; i < 5; ++i) {
-                	int tempX = x + i - ((int) (5 / 2));
-                	int tempY = y + j - ((int) (5 / 2));
-                	
-                	tempX = min(max(tempX, 0), w - 1);
-                	tempY = min(max(tempY, 0), h - 1);
-                	
-                    sum += lapOfGau[i][j] * orig[tempX + tempY * w];
-                    amount += lapOfGau[i][j];
-                }
-            }
-            
-            if (amount) sum /= amount;
-            
-            if (sum > 255) sum = 255;
-            if (sum < 0) sum = 0;
-            
-            mat[x + y * w] = sum;
-        }
-    }
+uByte* applyFilter(uByte *mat, int w, int h, const options *opts) {
+	/* one band of rows per thread, each with a ring of rows instead of a 
+	 * copy of the whole image */
+	if (opts->inPlace) {
+		int bands = omp_get_max_threads();
+		uByte *halo = (uByte*) takeBuffer(sizeof(uByte) * 4 * w * bands);
+		
+		/* before any band is overwritten */
+		for (int b = 0; b < bands; ++b) {
+			saveHalo(mat, w, h, h * b / bands, h * (b + 1) / bands, 
+				halo + 4 * w * b);
+		}
+		
+		#pragma omp parallel for schedule(runtime)
+		for (int b = 0; b < bands; ++b) {
+			filterInPlace(mat, w, h, h * b / bands, h * (b + 1) / bands, 
+				halo + 4 * w * b, opts->engine);
+		}
+		
+		giveBuffer(halo);
+		
+		return mat;
+	}
+	
+	int tw = opts->tileWidth, th = opts->tileHeight;
+	int tiles = tileCount(w, h, tw, th);
+	
+	uByte *orig = (uByte*) takeBuffer(sizeof(uByte) * (long) w * h);
+	firstTouch(orig, mat, w, h, opts);
+	
+	/* for each tile in the image */
+	#pragma omp parallel for schedule(runtime)
+	for (int t = 0; t < tiles; ++t) {
+		int x0, y0, x1, y1;
+		
+		tileBounds(t, w, h, &x0, &y0, &x1, &y1, tw, th);
+		filterTile(orig, mat, w, h, x0, y0, x1, y1, opts->engine);
+	}
     
-    free(orig);
+    giveBuffer(orig);
+    
+    return mat;
+}
+
+/* filters the rows [y0, y1) of src into out, which holds just those rows,
+ * the rows of a tile at a time per thread */
+void applyRows(const uByte *src, uByte *out, int w, int h, int y0, int y1, 
+	const options *opts) {
+	int th = opts->tileHeight;
+	int spans = spanCount(y0, y1, th);
+	
+	#pragma omp parallel for schedule(runtime)
+	for (int s = 0; s < spans; ++s) {
+		int s0, s1;
+		
+		spanBounds(s, y0, y1, &s0, &s1, th);
+		filterRows(src, out + (long) (s0 - y0) * w, w, h, s0, s1, 
+			opts->engine);
+	}
+}
+
+/* distribute for a window or the levels of a pyramid */
+int applyDistributed(image *img, int w, int h, const options *opts,
+	MPI_Comm comm, void *arg) {
+	return distribute(img, w, h, opts, comm, (const backend*) arg);
 }
 
 int main(int argc, char* argv[]) {
 	PixelLab *inImg = new PixelLab(); /* input image */
 	PixelLab *outImg = new PixelLab(); /* output image */
 	
-	int *outMat;
+	image *outMat = NULL; /* gray values of the whole image, on rank 0 */
 	
-	double start_t, end_t, total_t; /* time measure */
+	options opts; /* command line options */
 	
-	int origWidth, origHeight, /* original image size */
-		width, height, /* slice size */
-		*mat;
-		
-	int filterOffset = 2;
-	int startOffsetY, endOffsetY;
+	double start_t = 0, end_t, total_t; /* time measure, on rank 0 */
+	
+	int origWidth, origHeight; /* original image size */
+	int dims[2] = {0, 0}; /* image size, 0 when it could not be read */
+	int result;
+	
+	backend threads = {applyFilter, applyRows, touchBand}; /* how to filter */
 	
 	int rank; /* rank of process */
 	int p; /* number of processes */
-	MPI_Status status; /* return status for receive */
+	int provided; /* thread support of MPI */
+	MPI_Comm comm = MPI_COMM_WORLD;
 
-	/* start up MPI */
-	MPI_Init(&argc, &argv);
+	/* start up MPI, one thread at a time calling it: the main one, or the
+	 * decoding one of a farm */
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
 	
 	/* find out process rank */
-	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_rank(comm, &rank);
 	
 	/* find out number of processes */
-	MPI_Comm_size(MPI_COMM_WORLD, &p);
-	
-	/* round down p to nearest power of 2 */
-	p = powf(2.0f, floorf(log2f(p)));
-	
-	/* kill unused processes */
-	if (rank >= p) {
+	MPI_Comm_size(comm, &p);
+
+	if (provided < MPI_THREAD_SERIALIZED) {
+		if (rank == 0)
+			cout << "Error: this MPI cannot be called from more than one "
+				"thread." << endl;
+
 		MPI_Finalize();
-		return 0;
+		return -1;
 	}
 
 	/* validates arguments */
-	if (argc != 2) {
+	if (parseOptions(argc, argv, &opts) != 0) {
 		if (rank == 0)
-			cout << "Usage: " << argv[0] << " (image path)" << endl;
+			printUsage(argv[0]);
 
 		MPI_Finalize();
 		return -1;
 	}
 
-	/* pre processing */
-	if (rank == 0) {
-		string inImgPath = argv[1];
-		FILE *fp = fopen(inImgPath.c_str(), "rb");
-	
-		if (!fp) {
-			if (rank == 0)
-				cout << "Error: image '" << inImgPath << "' not found." << endl;
-	
-			MPI_Finalize();
-			return -1;
-		}
+	/* smoothing of -B, kernels of -L, zero crossings of -z and the tile
+	 * cache of -k, if given */
+	blurSelect(opts.blur);
+	sigmaSelect(opts.sigma);
+	edgeSelect(opts.slope);
+	cacheSelect(opts.cache);
+
+	/* decodes, filters and encodes row by row, on a single process */
+	if (opts.stream) {
+		result = 0;
 		
-		fclose(fp);
+		if (rank == 0) {
+			start_t = MPI_Wtime();
+			
+			result = filterStream(opts.input, opts.output, opts.engine);
+			
+			end_t = MPI_Wtime();
+			
+			if (result == 0)
+				cout << "Time elapsed: " << end_t - start_t << "s" << endl;
+		}
 		
-		inImg->Read(inImgPath.c_str());
-		outImg->Copy(inImg);
+		MPI_Finalize();
 		
-		origWidth = inImg->GetWidth();
-		origHeight = inImg->GetHeight();
+		return result;
+	}
+	
+	setupThreads(&opts);
+	
+	/* phases and tiles recorded for -j */
+	if (opts.trace) traceStart(comm, opts.counters);
+	
+	/* many images, a share of them per process or handed out on demand,
+	 * each through a decode, filter and encode pipeline */
+	if (opts.batchDir) {
+		int failures, total;
 		
-		width = origWidth;
-		height = origHeight / p;
+		start_t = MPI_Wtime();
 		
-		cout << "# of processes: " << p << endl;
-		cout << "Slice size: w = " << width << "; h = " << height << endl;
+		if (opts.farm)
+			failures = farmBatch(&opts, applyFilter, comm);
+		else
+			failures = filterBatch(&opts, applyFilter, rank, p);
 		
-		/* starts timer */
-		start_t = MPI_Wtime();
+		MPI_Reduce(&failures, &total, 1, MPI_INT, MPI_SUM, 0, comm);
 		
-		outMat = (int*) malloc(sizeof(int) * origWidth * origWidth);
+		if (rank == 0) {
+			if (total)
+				cout << total << " images failed." << endl;
 			
-		for (int y = 0; y < origHeight; y++) {
-			for (int x = 0; x < origWidth; x++) {
-				outMat[x + y * origWidth] = inImg->GetGrayValue(x, y);
-			}
+			cout << "Time elapsed: " << MPI_Wtime() - start_t << "s" << endl;
 		}
+		
+		if (opts.cache) printCache(comm);
+		if (opts.trace) traceWrite(comm, opts.trace);
+		
+		MPI_Finalize();
+		
+		return failures? -1 : 0;
 	}
 	
-	/* splits image */
-	if (rank == 0) {
-		for (int i = 1; i < p; i++) {
-			startOffsetY = height * i - filterOffset < 0? 
-				0 : filterOffset;
-			endOffsetY = height * (i + 1) + filterOffset > origHeight? 
-				0 : filterOffset;
-			
-			MPI_Send(&width, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-			MPI_Send(&height, 1, MPI_INT, i, 1, MPI_COMM_WORLD);
-			
-			MPI_Send(&startOffsetY, 1, MPI_INT, i, 8, MPI_COMM_WORLD);
-			MPI_Send(&endOffsetY, 1, MPI_INT, i, 9, MPI_COMM_WORLD);
-			
-			MPI_Send(outMat + (width * height * i) - (startOffsetY * width), 
-				width * (startOffsetY + height + endOffsetY),
-				MPI_INT, i, 2, MPI_COMM_WORLD);
-		}
+	/* a window or a pyramid of the image rather than all of it, split by
+	 * rank 0 like a whole image */
+	if (opts.roiWidth || opts.levels) {
+		start_t = MPI_Wtime();
 		
-		startOffsetY = 0;
-		endOffsetY = height + filterOffset <= origHeight?
-			filterOffset : 0;
+		result = opts.levels?
+			filterPyramid(&opts, comm, applyDistributed, &threads) :
+			filterWindow(&opts, comm, applyDistributed, &threads);
 		
-		mat = outMat;
-	} else {
-		MPI_Recv(&width, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
-		MPI_Recv(&height, 1, MPI_INT, 0, 1, MPI_COMM_WORLD, &status);
+		if (rank == 0 && result == 0)
+			cout << "Time elapsed: " << MPI_Wtime() - start_t << "s" << endl;
 		
-		MPI_Recv(&startOffsetY, 1, MPI_INT, 0, 8, MPI_COMM_WORLD, &status);
-		MPI_Recv(&endOffsetY, 1, MPI_INT, 0, 9, MPI_COMM_WORLD, &status);
+		if (opts.cache) printCache(comm);
+		if (opts.trace) traceWrite(comm, opts.trace);
 		
-		mat = (int*) malloc(sizeof(int) * width * (startOffsetY + height + endOffsetY));
+		MPI_Finalize();
 		
-		MPI_Recv(mat, width * (startOffsetY + height + endOffsetY), 
-			MPI_INT, 0, 2, MPI_COMM_WORLD, &status);
+		return result;
 	}
 	
-	/* applies filter */
-	applyFilter(mat, width, startOffsetY + height + endOffsetY);
+	/* PGM and raw images need no decoding, nor rank 0 to split them */
+	if (formatOf(opts.input) != FORMAT_PNG) {
+		result = distributeMapped(&opts, comm, &threads, omp_get_max_threads());
+		
+		if (opts.cache) printCache(comm);
+		if (opts.trace) traceWrite(comm, opts.trace);
+		
+		MPI_Finalize();
+		
+		return result;
+	}
 	
-	/* joins image */
+	/* pre processing */
 	if (rank == 0) {
-		int* temp = (int*) malloc(sizeof(int) * width * height);
-		
-		for (int i = 1; i < p; i++) {
-			MPI_Recv(temp, width * height, MPI_INT, 
-				MPI_ANY_TAG, 3, MPI_COMM_WORLD, &status);
+		string inImgPath = opts.input;
+		FILE *fp = fopen(inImgPath.c_str(), "rb");
+	
+		if (!fp) {
+			cout << "Error: image '" << inImgPath << "' not found." << endl;
+		} else {
+			fclose(fp);
 			
-			memcpy(outMat + (width * height * status.MPI_SOURCE), 
-				temp, sizeof(int) * width * height);
-		}
-		
-		for (int y = 0; y < origHeight; y++) {
-			for (int x = 0; x < origWidth; x++) {
-				outImg->SetGrayValue(x, y, outMat[x + y * origWidth]);
-			}
+			enterPhase(PHASE_DECODE);
+			inImg->Read(inImgPath.c_str());
+			outImg->Copy(inImg);
+			
+			dims[0] = inImg->GetWidth();
+			dims[1] = inImg->GetHeight();
 		}
+	}
+	
+	/* every process works out the split from the image size */
+	MPI_Bcast(dims, 2, MPI_INT, 0, comm);
+	
+	origWidth = dims[0];
+	origHeight = dims[1];
+	
+	if (origWidth == 0) {
+		MPI_Finalize();
+		return -1;
+	}
+	
+	if (rank == 0) {
+		int rows, cols, x0, y0, x1, y1;
 		
-		// finishes timer
-		end_t = MPI_Wtime();
+		cout << "# of processes: " << p << endl;
 		
-		total_t = end_t - start_t;
-		cout << "Time elapsed: " << total_t << "s" << endl;
+		if (gridOf(p, &opts, &rows, &cols) == 0) {
+			blockBounds(0, origWidth, origHeight, rows, cols, &x0, &y0, &x1, &y1);
+			cout << "Slice size: w = " << x1 - x0 << "; h = " << y1 - y0 << endl;
+		}
 		
-		outImg->Save("examples/lenaGrayOut.png");
+		/* starts timer */
+		start_t = MPI_Wtime();
+		enterPhase(PHASE_INGEST);
 		
-		free(temp);
-		free(inImg);
-		free(outImg);
-		free(outMat);
-	} else {
-		MPI_Send(mat + (startOffsetY * width), width * height, 
-			MPI_INT, 0, 3, MPI_COMM_WORLD);
+		outMat = ingest(inImg);
+	}
+	
+	/* splits image, applies filter and joins image */
+	result = distribute(outMat, origWidth, origHeight, &opts, comm, &threads);
+	
+	if (rank == 0) {
+		if (result == 0) {
+			enterPhase(PHASE_ENCODE);
+			
+			if (formatOf(opts.output) == FORMAT_PNG)
+				egress(outMat, outImg);
+			
+			// finishes timer
+			end_t = MPI_Wtime();
+			
+			total_t = end_t - start_t;
+			cout << "Time elapsed: " << total_t << "s" << endl;
+			
+			if (formatOf(opts.output) == FORMAT_PNG)
+				outImg->Save(opts.output);
+			else
+				saveMapped(outMat, opts.output, formatOf(opts.output));
+		}
 		
-		free(mat);
+		delete inImg;
+		delete outImg;
+		deleteImage(outMat);
 	}
 	
+	if (opts.cache && result == 0)
+		printCache(comm);
+	
+	if (opts.csv && result == 0)
+		printPhases(comm, omp_get_max_threads(), origWidth, origHeight);
+	
+	if (opts.trace && result == 0)
+		traceWrite(comm, opts.trace);
+	
 	// shuts down MPI
 	MPI_Finalize();
 	
-	return 0;
-}
\ No newline at end of file
+	return result;
+}
@@ -12,16 +12,25 @@ laplacian-of-gaussian filter.
 #include <string>
 #include <cstring>
 #include <cstdio>
-#include <ctime>
 #include <cmath>
-#include <sys/sysinfo.h>
-#include <pthread.h>
 #include "mpi.h"
 #include "pixelLab.h"
 #include "logcm.h"
-
-#define DEBUG 1
-#define printflush(s, ...) do {if (DEBUG) {printf(s, ##__VA_ARGS__); fflush(stdout);}} while (0)
+#include "convolve.h"
+#include "separable.h"
+#include "edges.h"
+#include "image.h"
+#include "options.h"
+#include "stream.h"
+#include "mapped.h"
+#include "distribute.h"
+#include "batch.h"
+#include "farm.h"
+#include "timing.h"
+#include "buffers.h"
+#include "cache.h"
+#include "region.h"
+#include "pool.h"
 
 using std::cout;
 using std::endl;
@@ -31,240 +40,346 @@ using std::string;
 using std::memcpy;
 
 typedef struct {
-	int idt;
-	int start_col, end_col;
 	int width, height;
-	int *mat, *orig;
-} thread_arg, *ptr_thread_arg;
+	uByte *mat, *orig;
+	engine_t engine;
+	uByte *halo; /* rows around each band, when filtering in place */
+	int bands;
+	int start_row, end_row;
+	int tile_w, tile_h;
+} job_arg, *ptr_job_arg;
+
+pool *workers; /* started once per process */
 
-void* thread_func(void *arg) {
-	ptr_thread_arg t_arg = (ptr_thread_arg) arg;
-	
-	/* for each pixel in the image */
-	for (int x = t_arg->start_col; x < t_arg->end_col; ++x) {
-        for (int y = 0; y < t_arg->height; ++y) {
-            int sum = 0;
-            int amount = 0;
-            
-            /* apply the kernel matrix */
-            for (int j = 0; j < 5; ++j) {
-                for (int i = 0; i < 5; ++i) {
-                	int tempX = x + i - ((int) (5 / 2));
-                	int tempY = y + j - ((int) (5 / 2));
-                	
-                	tempX = min(max(tempX, 0), t_arg->width - 1);
-                	tempY = min(max(tempY, 0), t_arg->height - 1);
-                	
-                    sum += lapOfGau[i][j] * 
-                    	t_arg->orig[tempX + tempY * t_arg->width];
-                    amount += lapOfGau[i][j];
-                }
-            }
-            
-            if (amount) sum /= amount;
-            
-            if (sum > 255) sum = 255;
-            if (sum < 0) sum = 0;
-            
-            t_arg->mat[x + y * t_arg->width] = sum;
-        }
-    }
+void band_func(int b, void *arg) {
+	ptr_job_arg j_arg = (ptr_job_arg) arg;
+	int h = j_arg->height;
+	
+	filterInPlace(j_arg->mat, j_arg->width, h, 
+		h * b / j_arg->bands, h * (b + 1) / j_arg->bands, 
+		j_arg->halo + 4 * j_arg->width * b, j_arg->engine);
 }
 
-int* applyFilter(int *mat, int w, int h) {
-	int *orig = (int*) malloc(sizeof(int) * w * h);
-	memcpy(orig, mat, sizeof(int) * w * h);
+void tile_func(int t, void *arg) {
+	ptr_job_arg j_arg = (ptr_job_arg) arg;
+	int x0, y0, x1, y1;
 	
-	int num_threads = 4;//;get_nprocs();
-	pthread_t threads[num_threads];
-	thread_arg args[num_threads];
+	tileBounds(t, j_arg->width, j_arg->height, &x0, &y0, &x1, &y1, 
+		j_arg->tile_w, j_arg->tile_h);
+	filterTile(j_arg->orig, j_arg->mat, j_arg->width, j_arg->height,
+		x0, y0, x1, y1, j_arg->engine);
+}
+
+void rows_func(int t, void *arg) {
+	ptr_job_arg j_arg = (ptr_job_arg) arg;
+	int y0, y1;
+	
+	spanBounds(t, j_arg->start_row, j_arg->end_row, &y0, &y1, j_arg->tile_h);
 	
-	for (int i = 0; i < num_threads; ++i) {
-		args[i].idt = i;
+	/* mat holds just the rows [start_row, end_row) */
+	filterRows(j_arg->orig, j_arg->mat + (long) (y0 - j_arg->start_row) * 
+		j_arg->width, j_arg->width, j_arg->height, y0, y1, j_arg->engine);
+}
+
+uByte* applyFilter(uByte *mat, int w, int h, const options *opts) {
+	job_arg args;
+	
+	args.width = w;
+	args.height = h;
+	args.mat = mat;
+	args.engine = opts->engine;
+	args.tile_w = opts->tileWidth;
+	args.tile_h = opts->tileHeight;
+	
+	/* one band of rows per thread, each with a ring of rows instead of a 
+	 * copy of the whole image */
+	if (opts->inPlace) {
+		args.bands = poolSize(workers);
+		args.halo = (uByte*) takeBuffer(sizeof(uByte) * 4 * w * args.bands);
 		
-		args[i].width = w;
-		args[i].height = h;
+		/* before any band is overwritten */
+		for (int b = 0; b < args.bands; ++b) {
+			saveHalo(mat, w, h, h * b / args.bands, h * (b + 1) / args.bands, 
+				args.halo + 4 * w * b);
+		}
 		
-		args[i].mat = mat;
-		args[i].orig = orig;
+		runPool(workers, args.bands, band_func, &args);
 		
-		args[i].start_col = (int) ((1.0f * w / num_threads) * i);
-		args[i].end_col = (int) ((1.0f * w / num_threads) * (i + 1));
+		giveBuffer(args.halo);
 		
-		pthread_create(&(threads[i]), NULL, thread_func, &(args[i]));
+		return mat;
 	}
 	
-	for (int i = 0; i < num_threads; ++i) {
-		pthread_join(threads[i], NULL);
-	}
+	args.orig = (uByte*) takeBuffer(sizeof(uByte) * (long) w * h);
+	memcpy(args.orig, mat, sizeof(uByte) * (long) w * h);
+	
+	/* tiles are spread over the pool, idle threads stealing from busy ones */
+	runPool(workers, tileCount(w, h, args.tile_w, args.tile_h), tile_func, 
+		&args);
     
-    free(orig);
+    giveBuffer(args.orig);
+    
+    return mat;
+}
+
+/* filters the rows [y0, y1) of src into out, which holds just those rows,
+ * the rows of a tile per task */
+void applyRows(const uByte *src, uByte *out, int w, int h, int y0, int y1, 
+	const options *opts) {
+	job_arg args;
+	
+	args.width = w;
+	args.height = h;
+	args.orig = (uByte*) src;
+	args.mat = out;
+	args.engine = opts->engine;
+	args.start_row = y0;
+	args.end_row = y1;
+	args.tile_h = opts->tileHeight;
+	
+	runPool(workers, spanCount(y0, y1, args.tile_h), rows_func, &args);
+}
+
+/* distribute for a window or the levels of a pyramid */
+int applyDistributed(image *img, int w, int h, const options *opts,
+	MPI_Comm comm, void *arg) {
+	return distribute(img, w, h, opts, comm, (const backend*) arg);
 }
 
 int main(int argc, char* argv[]) {
 	PixelLab *inImg = new PixelLab(); /* input image */
 	PixelLab *outImg = new PixelLab(); /* output image */
 	
-	int *outMat;
+	image *outMat = NULL; /* gray values of the whole image, on rank 0 */
 	
-	double start_t, end_t, total_t; /* time measure */
+	options opts; /* command line options */
 	
-	int origWidth, origHeight, /* original image size */
-		width, height, /* slice size */
-		*mat;
-		
-	int filterOffset = 2;
-	int startOffsetY, endOffsetY;
+	double start_t = 0, end_t, total_t; /* time measure, on rank 0 */
+	
+	int origWidth, origHeight; /* original image size */
+	int dims[2] = {0, 0}; /* image size, 0 when it could not be read */
+	int result;
+	
+	backend threads = {applyFilter, applyRows, NULL}; /* how to filter */
 	
 	int rank; /* rank of process */
 	int p; /* number of processes */
-	MPI_Status status; /* return status for receive */
+	int provided; /* thread support of MPI */
+	MPI_Comm comm = MPI_COMM_WORLD;
 
-	/* start up MPI */
-	MPI_Init(&argc, &argv);
+	/* start up MPI, one thread at a time calling it: the main one, or the
+	 * decoding one of a farm */
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
 	
 	/* find out process rank */
-	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	MPI_Comm_rank(comm, &rank);
 	
 	/* find out number of processes */
-	MPI_Comm_size(MPI_COMM_WORLD, &p);
-	
-	/* round down p to nearest power of 2 */
-	p = powf(2.0f, floorf(log2f(p)));
-	
-	/* kill unused processes */
-	if (rank >= p) {
+	MPI_Comm_size(comm, &p);
+
+	if (provided < MPI_THREAD_SERIALIZED) {
+		if (rank == 0)
+			cout << "Error: this MPI cannot be called from more than one "
+				"thread." << endl;
+
 		MPI_Finalize();
-		return 0;
+		return -1;
 	}
 
 	/* validates arguments */
-	if (argc != 2) {
+	if (parseOptions(argc, argv, &opts) != 0) {
 		if (rank == 0)
-			cout << "Usage: " << argv[0] << " (image path)" << endl;
+			printUsage(argv[0]);
 
 		MPI_Finalize();
 		return -1;
 	}
 
-	/* pre processing */
-	if (rank == 0) {
-		string inImgPath = argv[1];
-		FILE *fp = fopen(inImgPath.c_str(), "rb");
-	
-		if (!fp) {
-			if (rank == 0)
-				cout << "Error: image '" << inImgPath << "' not found." << endl;
-	
-			MPI_Finalize();
-			return -1;
-		}
+	/* smoothing of -B, kernels of -L, zero crossings of -z and the tile
+	 * cache of -k, if given */
+	blurSelect(opts.blur);
+	sigmaSelect(opts.sigma);
+	edgeSelect(opts.slope);
+	cacheSelect(opts.cache);
+
+	/* decodes, filters and encodes row by row, on a single process */
+	if (opts.stream) {
+		result = 0;
 		
-		fclose(fp);
+		if (rank == 0) {
+			start_t = MPI_Wtime();
+			
+			result = filterStream(opts.input, opts.output, opts.engine);
+			
+			end_t = MPI_Wtime();
+			
+			if (result == 0)
+				cout << "Time elapsed: " << end_t - start_t << "s" << endl;
+		}
 		
-		inImg->Read(inImgPath.c_str());
-		outImg->Copy(inImg);
+		MPI_Finalize();
 		
-		origWidth = inImg->GetWidth();
-		origHeight = inImg->GetHeight();
+		return result;
+	}
+	
+	/* paid once per process, whatever the number of images */
+	workers = newPool(opts.threads);
+	
+	/* phases and tiles recorded for -j */
+	if (opts.trace) traceStart(comm, opts.counters);
+	
+	/* many images, a share of them per process or handed out on demand,
+	 * each through a decode, filter and encode pipeline */
+	if (opts.batchDir) {
+		int failures, total;
 		
-		width = origWidth;
-		height = origHeight / p;
+		start_t = MPI_Wtime();
 		
-		cout << "# of processes: " << p << endl;
-		cout << "Slice size: w = " << width << "; h = " << height << endl;
+		if (opts.farm)
+			failures = farmBatch(&opts, applyFilter, comm);
+		else
+			failures = filterBatch(&opts, applyFilter, rank, p);
 		
-		/* starts timer */
-		start_t = MPI_Wtime();
+		MPI_Reduce(&failures, &total, 1, MPI_INT, MPI_SUM, 0, comm);
 		
-		outMat = (int*) malloc(sizeof(int) * origWidth * origWidth);
+		if (rank == 0) {
+			if (total)
+				cout << total << " images failed." << endl;
 			
-		for (int y = 0; y < origHeight; y++) {
-			for (int x = 0; x < origWidth; x++) {
-				outMat[x + y * origWidth] = inImg->GetGrayValue(x, y);
-			}
+			cout << "Time elapsed: " << MPI_Wtime() - start_t << "s" << endl;
 		}
+		
+		if (opts.cache) printCache(comm);
+		if (opts.trace) traceWrite(comm, opts.trace);
+		
+		deletePool(workers);
+		MPI_Finalize();
+		
+		return failures? -1 : 0;
 	}
 	
-	/* splits image */
-	if (rank == 0) {
-		for (int i = 1; i < p; i++) {
-			startOffsetY = height * i - filterOffset < 0? 
-				0 : filterOffset;
-			endOffsetY = height * (i + 1) + filterOffset > origHeight? 
-				0 : filterOffset;
-			
-			MPI_Send(&width, 1, MPI_INT, i, 0, MPI_COMM_WORLD);
-			MPI_Send(&height, 1, MPI_INT, i, 1, MPI_COMM_WORLD);
-			
-			MPI_Send(&startOffsetY, 1, MPI_INT, i, 8, MPI_COMM_WORLD);
-			MPI_Send(&endOffsetY, 1, MPI_INT, i, 9, MPI_COMM_WORLD);
-			
-			MPI_Send(outMat + (width * height * i) - (startOffsetY * width), 
-				width * (startOffsetY + height + endOffsetY),
-				MPI_INT, i, 2, MPI_COMM_WORLD);
-		}
+	/* a window or a pyramid of the image rather than all of it, split by
+	 * rank 0 like a whole image */
+	if (opts.roiWidth || opts.levels) {
+		start_t = MPI_Wtime();
 		
-		startOffsetY = 0;
-		endOffsetY = height + filterOffset <= origHeight?
-			filterOffset : 0;
+		result = opts.levels?
+			filterPyramid(&opts, comm, applyDistributed, &threads) :
+			filterWindow(&opts, comm, applyDistributed, &threads);
 		
-		mat = outMat;
-	} else {
-		MPI_Recv(&width, 1, MPI_INT, 0, 0, MPI_COMM_WORLD, &status);
-		MPI_Recv(&height, 1, MPI_INT, 0, 1, MPI_COMM_WORLD, &status);
+		if (rank == 0 && result == 0)
+			cout << "Time elapsed: " << MPI_Wtime() - start_t << "s" << endl;
 		
-		MPI_Recv(&startOffsetY, 1, MPI_INT, 0, 8, MPI_COMM_WORLD, &status);
-		MPI_Recv(&endOffsetY, 1, MPI_INT, 0, 9, MPI_COMM_WORLD, &status);
+		if (opts.cache) printCache(comm);
+		if (opts.trace) traceWrite(comm, opts.trace);
 		
-		mat = (int*) malloc(sizeof(int) * width * (startOffsetY + height + endOffsetY));
+		deletePool(workers);
+		MPI_Finalize();
 		
-		MPI_Recv(mat, width * (startOffsetY + height + endOffsetY), 
-			MPI_INT, 0, 2, MPI_COMM_WORLD, &status);
+		return result;
 	}
 	
-	/* applies filter */
-	applyFilter(mat, width, startOffsetY + height + endOffsetY);
+	/* PGM and raw images need no decoding, nor rank 0 to split them */
+	if (formatOf(opts.input) != FORMAT_PNG) {
+		result = distributeMapped(&opts, comm, &threads, poolSize(workers));
+		
+		if (opts.cache) printCache(comm);
+		if (opts.trace) traceWrite(comm, opts.trace);
+		
+		deletePool(workers);
+		MPI_Finalize();
+		
+		return result;
+	}
 	
-	/* joins image */
+	/* pre processing */
 	if (rank == 0) {
-		int* temp = (int*) malloc(sizeof(int) * width * height);
-		
-		for (int i = 1; i < p; i++) {
-			MPI_Recv(temp, width * height, MPI_INT, 
-				MPI_ANY_TAG, 3, MPI_COMM_WORLD, &status);
+		string inImgPath = opts.input;
+		FILE *fp = fopen(inImgPath.c_str(), "rb");
+	
+		if (!fp) {
+			cout << "Error: image '" << inImgPath << "' not found." << endl;
+		} else {
+			fclose(fp);
 			
-			memcpy(outMat + (width * height * status.MPI_SOURCE), 
-				temp, sizeof(int) * width * height);
-		}
-		
-		for (int y = 0; y < origHeight; y++) {
-			for (int x = 0; x < origWidth; x++) {
-				outImg->SetGrayValue(x, y, outMat[x + y * origWidth]);
-			}
+			enterPhase(PHASE_DECODE);
+			inImg->Read(inImgPath.c_str());
+			outImg->Copy(inImg);
+			
+			dims[0] = inImg->GetWidth();
+			dims[1] = inImg->GetHeight();
 		}
+	}
+	
+	/* every process works out the split from the image size */
+	MPI_Bcast(dims, 2, MPI_INT, 0, comm);
+	
+	origWidth = dims[0];
+	origHeight = dims[1];
+	
+	if (origWidth == 0) {
+		deletePool(workers);
+		MPI_Finalize();
+		return -1;
+	}
+	
+	if (rank == 0) {
+		int rows, cols, x0, y0, x1, y1;
 		
-		// finishes timer
-		end_t = MPI_Wtime();
+		cout << "# of processes: " << p << endl;
 		
-		total_t = end_t - start_t;
-		cout << "Time elapsed: " << total_t << "s" << endl;
+		if (gridOf(p, &opts, &rows, &cols) == 0) {
+			blockBounds(0, origWidth, origHeight, rows, cols, &x0, &y0, &x1, &y1);
+			cout << "Slice size: w = " << x1 - x0 << "; h = " << y1 - y0 << endl;
+		}
 		
-		outImg->Save("examples/lenaGrayOut.png");
+		/* starts timer */
+		start_t = MPI_Wtime();
+		enterPhase(PHASE_INGEST);
 		
-		free(temp);
-		free(inImg);
-		free(outImg);
-		free(outMat);
-	} else {
-		MPI_Send(mat + (startOffsetY * width), width * height, 
-			MPI_INT, 0, 3, MPI_COMM_WORLD);
+		outMat = ingest(inImg);
+	}
+	
+	/* splits image, applies filter and joins image */
+	result = distribute(outMat, origWidth, origHeight, &opts, comm, &threads);
+	
+	if (rank == 0) {
+		if (result == 0) {
+			enterPhase(PHASE_ENCODE);
+			
+			if (formatOf(opts.output) == FORMAT_PNG)
+				egress(outMat, outImg);
+			
+			// finishes timer
+			end_t = MPI_Wtime();
+			
+			total_t = end_t - start_t;
+			cout << "Time elapsed: " << total_t << "s" << endl;
+			
+			if (formatOf(opts.output) == FORMAT_PNG)
+				outImg->Save(opts.output);
+			else
+				saveMapped(outMat, opts.output, formatOf(opts.output));
+		}
 		
-		free(mat);
+		delete inImg;
+		delete outImg;
+		deleteImage(outMat);
 	}
 	
+	if (opts.cache && result == 0)
+		printCache(comm);
+	
+	if (opts.csv && result == 0)
+		printPhases(comm, poolSize(workers), origWidth, origHeight);
+	
+	if (opts.trace && result == 0)
+		traceWrite(comm, opts.trace);
+	
+	deletePool(workers);
+	
 	// shuts down MPI
 	MPI_Finalize();
 	
-	return 0;
-}
\ No newline at end of file
+	return result;
+}
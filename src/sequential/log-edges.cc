@@ -12,14 +12,23 @@ laplacian-of-gaussian filter.
 #include <string>
 #include <cstring>
 #include <cstdio>
-#include <ctime>
 #include <cmath>
+#include <cstdlib>
 #include "mpi.h"
 #include "pixelLab.h"
 #include "logcm.h"
-
-#define DEBUG 1
-#define printflush(s, ...) do {if (DEBUG) {printf(s, ##__VA_ARGS__); fflush(stdout);}} while (0)
+#include "convolve.h"
+#include "separable.h"
+#include "edges.h"
+#include "image.h"
+#include "options.h"
+#include "stream.h"
+#include "mapped.h"
+#include "batch.h"
+#include "timing.h"
+#include "buffers.h"
+#include "cache.h"
+#include "region.h"
 
 using std::cout;
 using std::endl;
@@ -28,74 +37,237 @@ using std::max;
 using std::string;
 using std::memcpy;
 
-static long get_nanos(void) {
-    struct timespec ts;
-    timespec_get(&ts, TIME_UTC);
-    return (long) ts.tv_sec * 1000000000L + ts.tv_nsec;
+uByte* applyFilter(uByte *mat, int w, int h, const options *opts) {
+	/* a ring of rows instead of a copy of the whole image */
+	if (opts->inPlace) {
+		filterInPlace(mat, w, h, 0, h, NULL, opts->engine);
+		
+		return mat;
+	}
+	
+	uByte *orig = (uByte*) takeBuffer(sizeof(uByte) * (long) w * h);
+	memcpy(orig, mat, sizeof(uByte) * (long) w * h);
+	
+	/* for each tile in the image */
+	filterImage(orig, mat, w, h, opts->engine);
+    
+    giveBuffer(orig);
+    
+    return mat;
 }
-
-int* applyFilter(int *mat, int w, int h) {
-	int sum, amount, tempX, tempY;
-	
-	int *orig = (int*) malloc(sizeof(int) * w * h);
-	memcpy(orig, mat, sizeof(int) * w * h);
-	
-	/* for each pixel in the image */
-    for (int x = 0; x < w; ++x) {
-        for (int y = 0; y < h; ++y) {
-            sum = 0;
-            amount = 0;
-            
-            /* apply the kernel matrix */
-            for (int j = 0; j < 5; ++j) {
-                for (int i = 0; i < 5; ++i) {
-                	tempX = x + i - ((int) (5 / 2));
-                	tempY = y + j - ((int) (5 / 2));
-                	
-                	tempX = min(max(tempX, 0), w - 1);
-                	tempY = min(max(tempY, 0), h - 1);
-                	
-                    sum += lapOfGau[i][j] * orig[tempX + tempY * w];
-                    amount += lapOfGau[i][j];
-                }
-            }
-            
-            if (amount) sum /= amount;
-            
-            if (sum > 255) sum = 255;
-            if (sum < 0) sum = 0;
-            
-            mat[x + y * w] = sum;
-        }
-    }
     
-    free(orig);
+/* applyFilter for a window or the levels of a pyramid, on this process
+ * alone */
+int applyWhole(image *img, int w, int h, const options *opts, MPI_Comm,
+	void*) {
+	enterPhase(PHASE_FILTER);
+	applyFilter(img->data, w, h, opts);
+	
+	return 0;
+}
+
+/* seeds the random images of verify, the same on every run so that a
+ * mismatch can be reproduced */
+#define VERIFY_SEED 2017
+
+/* runs verifyEngines on the given image and on random ones whose sizes
+ * leave remainders for every SIMD width */
+int verify(const uByte *mat, int w, int h) {
+	int sizes[][2] = {{1, 1}, {4, 3}, {5, 5}, {37, 9}, {1061, 131}, {2083, 67}};
+	int failures = verifyEngines(mat, w, h);
+	
+	srand(VERIFY_SEED);
+	
+	for (int s = 0; s < 6; s++) {
+		int rw = sizes[s][0], rh = sizes[s][1];
+		uByte *img = (uByte*) malloc(sizeof(uByte) * rw * rh);
+		
+		for (int i = 0; i < rw * rh; i++) img[i] = rand() % 256;
+		
+		failures += verifyEngines(img, rw, rh);
+		
+		free(img);
+	}
+	
+	cout << "SIMD: " << simdName(simdDetect()) << "; " 
+		<< (failures? "engines differ" : "engines match") << endl;
+	
+	return failures;
+}
+
+/* filters a PGM or raw image straight from its mapping into a mapped 
+ * output, without decoding or copying either */
+int applyMapped(const options *opts) {
+	int w = opts->rawWidth, h = opts->rawHeight;
+	format_t outFormat = formatOf(opts->output);
+	long inOffset, outOffset;
+	image *in, *out;
+	double start_t;
+	
+	enterPhase(PHASE_DECODE);
+	
+	inOffset = readHeader(opts->input, formatOf(opts->input), &w, &h);
+	
+	if (inOffset < 0) return -1;
+	
+	in = mapRows(opts->input, inOffset, w, 0, h, false);
+	
+	if (!in) return -1;
+	
+	/* checks the engines instead of filtering */
+	if (opts->verify) {
+		int failures = verify(in->data, w, h);
+		
+		deleteImage(in);
+		
+		return failures? 1 : 0;
+	}
+	
+	if (outFormat == FORMAT_PNG) {
+		cout << "Error: mapped images are written as .pgm or .raw." << endl;
+		deleteImage(in);
+		
+		return -1;
+	}
+	
+	outOffset = createMapped(opts->output, outFormat, w, h);
+	out = outOffset < 0? NULL : mapRows(opts->output, outOffset, w, 0, h, true);
+	
+	if (!out) {
+		deleteImage(in);
+		
+		return -1;
+	}
+	
+	start_t = MPI_Wtime();
+	enterPhase(PHASE_FILTER);
+	
+	/* the rows of a tile at a time, as the parallel binaries do */
+	for (int s = 0; s < spanCount(0, h, opts->tileHeight); ++s) {
+		int y0, y1;
+		
+		spanBounds(s, 0, h, &y0, &y1, opts->tileHeight);
+		filterRows(in->data, out->data + (long) y0 * w, w, h, y0, y1, 
+			opts->engine);
+	}
+	
+	cout << "Time elapsed: " << MPI_Wtime() - start_t << "s" << endl;
+	
+	/* the pages written go back to the file */
+	enterPhase(PHASE_ENCODE);
+	deleteImage(in);
+	deleteImage(out);
+	
+	if (opts->csv) printPhases(MPI_COMM_WORLD, 1, w, h);
+	
+	return 0;
 }
 
 int main(int argc, char* argv[]) {
 	PixelLab *inImg = new PixelLab(); /* input image */
 	PixelLab *outImg = new PixelLab(); /* output image */
 	
-	int *outMat;
+	image *outMat; /* gray values of the whole image */
+	
+	options opts; /* command line options */
 	
 	double start_t, end_t, total_t; /* time measure */
 	
 	int origWidth, origHeight, /* original image size */
-		width, height, /* slice size */
-		*mat;
+		width, height; /* slice size */
+
 		
 	/* start up MPI */
 	MPI_Init(&argc, &argv);
 
 	/* validates arguments */
-	if (argc != 2) {
-		cout << "Usage: " << argv[0] << " (image path)" << endl;
+	if (parseOptions(argc, argv, &opts) != 0) {
+		printUsage(argv[0]);
 
 		return -1;
 	}
 
+	/* smoothing of -B, kernels of -L, zero crossings of -z and the tile
+	 * cache of -k, if given */
+	blurSelect(opts.blur);
+	sigmaSelect(opts.sigma);
+	edgeSelect(opts.slope);
+	cacheSelect(opts.cache);
+
+	/* decodes, filters and encodes row by row */
+	if (opts.stream) {
+		start_t = MPI_Wtime();
+		
+		int result = filterStream(opts.input, opts.output, opts.engine);
+		
+		end_t = MPI_Wtime();
+		
+		if (result == 0)
+			cout << "Time elapsed: " << end_t - start_t << "s" << endl;
+		
+		MPI_Finalize();
+		
+		return result;
+	}
+	
+	/* phases and tiles recorded for -j */
+	if (opts.trace) traceStart(MPI_COMM_WORLD, opts.counters);
+	
+	/* many images through a decode, filter and encode pipeline */
+	if (opts.batchDir) {
+		start_t = MPI_Wtime();
+		
+		int failures = filterBatch(&opts, applyFilter, 0, 1);
+		
+		end_t = MPI_Wtime();
+		
+		if (failures)
+			cout << failures << " images failed." << endl;
+		
+		cout << "Time elapsed: " << end_t - start_t << "s" << endl;
+		
+		if (opts.cache) printCache(MPI_COMM_WORLD);
+		if (opts.trace) traceWrite(MPI_COMM_WORLD, opts.trace);
+		
+		MPI_Finalize();
+		
+		return failures? -1 : 0;
+	}
+	
+	/* a window or a pyramid of the image rather than all of it, each process
+	 * on its own */
+	if (opts.roiWidth || opts.levels) {
+		start_t = MPI_Wtime();
+		
+		int result = opts.levels?
+			filterPyramid(&opts, MPI_COMM_SELF, applyWhole, NULL) :
+			filterWindow(&opts, MPI_COMM_SELF, applyWhole, NULL);
+		
+		if (result == 0)
+			cout << "Time elapsed: " << MPI_Wtime() - start_t << "s" << endl;
+		
+		if (opts.cache) printCache(MPI_COMM_WORLD);
+		if (opts.trace) traceWrite(MPI_COMM_WORLD, opts.trace);
+		
+		MPI_Finalize();
+		
+		return result;
+	}
+	
+	/* PGM and raw images need no decoding */
+	if (formatOf(opts.input) != FORMAT_PNG) {
+		int result = applyMapped(&opts);
+		
+		if (opts.cache && result == 0) printCache(MPI_COMM_WORLD);
+		if (opts.trace) traceWrite(MPI_COMM_WORLD, opts.trace);
+		
+		MPI_Finalize();
+		
+		return result;
+	}
+	
 	/* pre processing */
-	string inImgPath = argv[1];
+	string inImgPath = opts.input;
 	FILE *fp = fopen(inImgPath.c_str(), "rb");
 
 	if (!fp) {
@@ -106,6 +278,7 @@ int main(int argc, char* argv[]) {
 	
 	fclose(fp);
 	
+	enterPhase(PHASE_DECODE);
 	inImg->Read(inImgPath.c_str());
 	outImg->Copy(inImg);
 	
@@ -117,17 +290,27 @@ int main(int argc, char* argv[]) {
 	
 	/* starts timer */
 	start_t = MPI_Wtime();
+	enterPhase(PHASE_INGEST);
+	
+	outMat = ingest(inImg);
 	
-	outMat = (int*) malloc(sizeof(int) * origWidth * origWidth);
+	/* checks the engines instead of filtering */
+	if (opts.verify) {
+		int failures = verify(outMat->data, width, height);
+		
+		deleteImage(outMat);
+		MPI_Finalize();
 		
-	for (int y = 0; y < origHeight; y++) {
-		for (int x = 0; x < origWidth; x++) {
-			outMat[x + y * origWidth] = inImg->GetGrayValue(x, y);
-		}
+		return failures? 1 : 0;
 	}
 	
 	/* applies filter */
-	applyFilter(outMat, width, height);
+	enterPhase(PHASE_FILTER);
+	applyFilter(outMat->data, width, height, &opts);
+	enterPhase(PHASE_ENCODE);
+	
+	if (formatOf(opts.output) == FORMAT_PNG)
+		egress(outMat, outImg);
 		
 	// finishes timer
 	end_t = MPI_Wtime();
@@ -135,11 +318,18 @@ int main(int argc, char* argv[]) {
 	total_t = end_t - start_t;
 	cout << "Time elapsed: " << total_t << "s" << endl;
 	
-	outImg->Save("examples/lenaGrayOut.png");
+	if (formatOf(opts.output) == FORMAT_PNG)
+		outImg->Save(opts.output);
+	else
+		saveMapped(outMat, opts.output, formatOf(opts.output));
+	
+	if (opts.cache) printCache(MPI_COMM_WORLD);
+	if (opts.csv) printPhases(MPI_COMM_WORLD, 1, width, height);
+	if (opts.trace) traceWrite(MPI_COMM_WORLD, opts.trace);
 	
-	free(inImg);
-	free(outImg);
-	free(outMat);
+	delete inImg;
+	delete outImg;
+	deleteImage(outMat);
 	
 	MPI_Finalize();
 	
@@ -0,0 +1,186 @@
+#!/bin/sh
+# Checks every binary against test/expected, the output of the original
+# per-pixel loop of log-edges on the images of test/images, with every
+# engine and process count, then runs the checks of -V. Prints what failed
+# and exits with 1 if anything did.
+#
+# Settings, from the environment:
+#   MPIRUN    how parallel binaries are started, followed by the number of
+#             processes (default: mpirun -np)
+#   THREADS   threads per process, -t (default: 2)
+
+BIN=bin
+WORK=$BIN/test
+
+MPIRUN=${MPIRUN:-"mpirun -np"}
+THREADS=${THREADS:-2}
+failed=0
+
+mkdir -p $WORK
+
+# runs a command, printing it and what it said if it fails
+check() {
+	if ! "$@" > $WORK/log 2>&1; then
+		echo "failed: $*" >&2
+		cat $WORK/log >&2
+		failed=1
+
+		return 1
+	fi
+}
+
+# filters an image with a command, comparing the result to its expected
+# output
+same() {
+	image=$1
+	name=$(basename $image)
+	shift
+
+	rm -f $WORK/$name
+
+	if ! check "$@" -o $WORK/$name $image; then return; fi
+
+	if ! cmp -s $WORK/$name test/expected/$name; then
+		echo "differs from test/expected/$name: $*" >&2
+		failed=1
+	fi
+}
+
+for image in test/images/*.pgm; do
+	for engine in clamp split simd; do
+		same $image $BIN/sequential/log-edges -e $engine
+	done
+
+	for backend in open-mp pthreads; do
+		for np in 1 3; do
+			same $image $MPIRUN $np $BIN/parallel/$backend/log-edges -t $THREADS
+		done
+	done
+done
+
+# a window covering the whole image goes through the split of -g, -P and -H,
+# down to images too small to be split over the processes
+for image in test/images/noise-*.pgm; do
+	size=$(basename $image .pgm)
+	window="-R ${size#noise-}+0+0"
+
+	for backend in open-mp pthreads; do
+		parallel="$BIN/parallel/$backend/log-edges -t $THREADS $window"
+
+		same $image $MPIRUN 1 $parallel
+		same $image $MPIRUN 2 $parallel
+		same $image $MPIRUN 4 $parallel -g 2x2
+		same $image $MPIRUN 3 $parallel -P
+		same $image $MPIRUN 2 $parallel -H
+	done
+done
+
+# windows of lena decoded from PNG, plain and interlaced RGB, down to their
+# last row only, against the same windows of the PGM
+for window in 160x120+0+0 40x30+50+10 160x7+0+113 1x1+159+0; do
+	check $BIN/sequential/log-edges -R $window -o $WORK/window.pgm \
+		test/images/lena.pgm
+
+	for png in test/images/lena.png test/images/lena-interlaced.png; do
+		rm -f $WORK/window-png.pgm
+		check $MPIRUN 2 $BIN/parallel/pthreads/log-edges -t $THREADS \
+			-R $window -o $WORK/window-png.pgm $png
+
+		if ! cmp -s $WORK/window-png.pgm $WORK/window.pgm; then
+			echo "window $window of $png differs from the PGM" >&2
+			failed=1
+		fi
+	done
+done
+
+# a pyramid of lena down to 1x1, every level of it over more processes
+# than the coarse ones have rows, against the levels of the sequential one,
+# the finest being checked against test/expected too
+check $BIN/sequential/log-edges -p 9 -o $WORK/pyramid.pgm test/images/lena.pgm
+
+if ! cmp -s $WORK/pyramid-0.pgm test/expected/lena.pgm; then
+	echo "differs from test/expected/lena.pgm: -p 9" >&2
+	failed=1
+fi
+
+for backend in open-mp pthreads; do
+	for np in 2 4; do
+		rm -f $WORK/level-*.pgm
+		check $MPIRUN $np $BIN/parallel/$backend/log-edges -t $THREADS -p 9 \
+			-o $WORK/level.pgm test/images/lena.pgm
+
+		for k in 0 1 2 3 4 5 6 7 8; do
+			if ! cmp -s $WORK/level-$k.pgm $WORK/pyramid-$k.pgm; then
+				echo "level $k of -p 9 at $np processes of $backend differs" >&2
+				failed=1
+			fi
+		done
+	done
+done
+
+# filters an image with the cache of -k, checking how many tiles came from
+# it and that the result is the one filtered without it
+cached() {
+	expect=$1
+	shift
+
+	if ! check "$@" -k $WORK/cache -o $WORK/cached.pgm $WORK/tall.pgm; then
+		return
+	fi
+
+	if ! grep -q "^Tiles from cache: $expect\$" $WORK/log; then
+		echo "not $expect tiles from cache: $*" >&2
+		cat $WORK/log >&2
+		failed=1
+	fi
+
+	if ! cmp -s $WORK/cached.pgm $WORK/uncached.pgm; then
+		echo "differs from the result without the cache: $*" >&2
+		failed=1
+	fi
+}
+
+# the cache on an image 10 tiles high made of lena's rows, before and after
+# changing one pixel, which only the tile holding it reads: the sequential
+# binary filters it in tiles, and the bands and windows of the parallel
+# ones look up the same tiles
+rm -rf $WORK/cache
+
+{
+	printf 'P5\n160 640\n255\n'
+	for k in 1 2 3 4 5 6; do tail -c 19200 test/images/lena.pgm; done
+} | head -c $((15 + 160 * 640)) > $WORK/tall.pgm
+
+check $BIN/sequential/log-edges -o $WORK/uncached.pgm $WORK/tall.pgm
+cached "0 of 10" $BIN/sequential/log-edges
+
+printf '\0' | dd of=$WORK/tall.pgm bs=1 seek=$((15 + 200 * 160 + 80)) \
+	conv=notrunc 2> /dev/null
+check $BIN/sequential/log-edges -o $WORK/uncached.pgm $WORK/tall.pgm
+
+cached "9 of 10" $BIN/sequential/log-edges
+cached "10 of 10" $MPIRUN 2 $BIN/parallel/open-mp/log-edges -t $THREADS
+cached "10 of 10" $MPIRUN 5 $BIN/parallel/pthreads/log-edges -t $THREADS
+cached "10 of 10" $MPIRUN 2 $BIN/parallel/pthreads/log-edges -t $THREADS \
+	-R 160x640+0+0 -P
+
+# a window filters the tiles it cuts on its own, its halo included
+check $BIN/sequential/log-edges -R 160x512+0+64 -o $WORK/uncached.pgm \
+	$WORK/tall.pgm
+cached "8 of 10" $BIN/sequential/log-edges -R 160x512+0+64
+
+# engines and instruction sets against each other on fixed random images,
+# and fused smoothing and edge maps against their unfused versions
+for args in "" "-B average" "-B gaussian" "-z 8"; do
+	check $BIN/sequential/log-edges -V $args test/images/lena.pgm
+done
+
+# separable passes of -L against the whole kernel, within SIGMA_BOUND of
+# separable.h, from the smallest sigma to ones where the bound is reached
+for sigma in 1 1.4 2 3 4.5 8 16; do
+	check $BIN/sequential/log-edges -V -L $sigma test/images/lena.pgm
+done
+
+if [ $failed = 0 ]; then echo "All tests passed."; fi
+
+exit $failed